@@ -0,0 +1,165 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "lab1/IoLatReadCacheBench.hpp"
+#include "lab1/ScalingBench.hpp"
+#include "lab2/Cache.hpp"
+
+namespace lab1 {
+
+constexpr const char* KBlockSizeTestFileName = "blocksize_testfile.bin";
+// The file is four times the size of the cache, so that random reads keep missing.
+constexpr size_t KBlockSizeFileBytes = 64 * 1024 * 1024;
+constexpr size_t KBlockSizeCacheBytes = 16 * 1024 * 1024;
+// Request size of the sequential workload.
+constexpr size_t KSequentialReadSize = 64 * 1024;
+
+// Measurements of one workload with one block size.
+struct BlockSizeResult {
+  size_t block_size{};
+  const char* workload{};
+  double ops_per_sec{};
+  double mib_per_sec{};
+  uint64_t p50_ns{};
+  uint64_t p99_ns{};
+  double hit_rate{};
+  size_t misses{};  // Blocks fetched, each costing a pread unless a lower tier had it
+};
+
+inline void GenerateBlockSizeTestFile() {
+  const auto file = open(KBlockSizeTestFileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (file < 0) {
+    perror("open");
+    std::quick_exit(EXIT_FAILURE);
+  }
+
+  std::vector<char> buffer(1024 * 1024);
+  for (size_t i = 0; i < KBlockSizeFileBytes / buffer.size(); ++i) {
+    std::memset(buffer.data(), static_cast<int>('a' + i % 26), buffer.size());
+    const auto bytes_written = write(file, buffer.data(), buffer.size());
+    if (bytes_written != static_cast<ssize_t>(buffer.size())) {
+      perror("write");
+      close(file);
+      std::quick_exit(EXIT_FAILURE);
+    }
+  }
+  close(file);
+}
+
+// Runs iterations reads through a fresh cache of block_size blocks: random
+// KBenchBlockSize reads, or KSequentialReadSize reads wrapping around the file.
+inline BlockSizeResult RunBlockSizePoint(size_t block_size, bool sequential, int iterations) {
+  const auto cache = lab2::CreateCache(block_size, KBlockSizeCacheBytes / block_size);
+  const int file = cache->OpenFile(KBlockSizeTestFileName);
+  if (file < 0) {
+    perror("OpenFile");
+    std::quick_exit(EXIT_FAILURE);
+  }
+
+  const size_t read_size = sequential ? KSequentialReadSize : KBenchBlockSize;
+  const size_t num_records = KBlockSizeFileBytes / read_size;
+  std::mt19937 engine(42);
+  std::uniform_int_distribution<size_t> dist(0, num_records - 1);
+  std::vector<char> buffer(read_size);
+  std::vector<uint64_t> latencies;
+  latencies.reserve(iterations);
+
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    const size_t record = sequential ? static_cast<size_t>(i) % num_records : dist(engine);
+    const auto op_begin = std::chrono::steady_clock::now();
+    if (cache->LSeek(file, static_cast<off_t>(record * read_size), SEEK_SET) == -1 ||
+        cache->ReadFile(file, buffer.data(), read_size) != static_cast<ssize_t>(read_size)) {
+      perror("ReadFile");
+      std::quick_exit(EXIT_FAILURE);
+    }
+    const auto op_end = std::chrono::steady_clock::now();
+    latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(op_end - op_begin).count()
+    );
+    benchmark::DoNotOptimize(buffer);
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  const lab2::CacheStats stats = cache->GetStats();
+  cache->CloseFile(file);
+
+  BlockSizeResult result;
+  result.block_size = block_size;
+  result.workload = sequential ? "sequential" : "random";
+  const double seconds = std::chrono::duration<double>(end - begin).count();
+  result.ops_per_sec = seconds > 0 ? iterations / seconds : 0;
+  result.mib_per_sec = result.ops_per_sec * static_cast<double>(read_size) / (1024 * 1024);
+  result.p50_ns = Percentile(latencies, 0.5);
+  result.p99_ns = Percentile(latencies, 0.99);
+  const size_t lookups = stats.hits + stats.misses;
+  result.hit_rate = lookups > 0 ? static_cast<double>(stats.hits) / lookups : 0;
+  result.misses = stats.misses;
+  return result;
+}
+
+inline void PrintBlockSizeResults(const std::vector<BlockSizeResult>& results, bool csv) {
+  if (csv) {
+    std::printf("block_size,workload,ops_per_sec,mib_per_sec,p50_ns,p99_ns,hit_rate,misses\n");
+  } else {
+    std::printf(
+        "%10s %10s %12s %10s %9s %9s %8s %10s\n",
+        "block",
+        "workload",
+        "ops/s",
+        "MiB/s",
+        "p50 ns",
+        "p99 ns",
+        "hit %",
+        "misses"
+    );
+  }
+
+  for (const auto& result : results) {
+    std::printf(
+        csv ? "%zu,%s,%.0f,%.1f,%lu,%lu,%.4f,%zu\n"
+            : "%10zu %10s %12.0f %10.1f %9lu %9lu %8.2f %10zu\n",
+        result.block_size,
+        result.workload,
+        result.ops_per_sec,
+        result.mib_per_sec,
+        static_cast<unsigned long>(result.p50_ns),
+        static_cast<unsigned long>(result.p99_ns),
+        csv ? result.hit_rate : result.hit_rate * 100,
+        result.misses
+    );
+  }
+}
+
+// Compares the block sizes the cache is instantiated for, with the same
+// memory, on random KBenchBlockSize reads and sequential KSequentialReadSize
+// reads. Larger blocks divide the misses of sequential reads, and with them
+// the preads and block metadata, by the block size ratio, while random reads
+// pay for reading and caching the rest of each block they touch.
+inline void BlockSizeBenchmark(int iterations, bool csv) {
+  GenerateBlockSizeTestFile();
+
+  std::vector<BlockSizeResult> results;
+  for (const bool sequential : {false, true}) {
+    for (const size_t block_size : lab2::KBlockSizes) {
+      results.push_back(RunBlockSizePoint(block_size, sequential, iterations));
+    }
+  }
+  PrintBlockSizeResults(results, csv);
+  unlink(KBlockSizeTestFileName);
+}
+
+}  // namespace lab1
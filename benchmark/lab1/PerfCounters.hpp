@@ -0,0 +1,112 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+namespace lab1 {
+
+// Events counted per benchmark thread.
+enum class PerfEvent : size_t {
+  Cycles,
+  Instructions,
+  LlcMisses,
+  ContextSwitches,
+  Count,
+};
+
+// Counts PerfEvent events of the calling thread through perf_event_open.
+// Events the kernel refuses (no PMU in a VM, perf_event_paranoid) read as -1.
+class PerfCounters {
+public:
+  static constexpr size_t KNumEvents = static_cast<size_t>(PerfEvent::Count);
+
+  PerfCounters() {
+    fds_.fill(-1);
+    Open(PerfEvent::Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    Open(PerfEvent::Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    Open(PerfEvent::LlcMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    Open(PerfEvent::ContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+  }
+
+  ~PerfCounters() {
+    for (const int fd : fds_) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  void Start() {
+    for (const int fd : fds_) {
+      if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  void Stop() {
+    for (const int fd : fds_) {
+      if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+  }
+
+  // Counts between Start and Stop, scaled up if the kernel multiplexed the
+  // counter with others.
+  std::array<int64_t, KNumEvents> Read() const {
+    std::array<int64_t, KNumEvents> counts{};
+    for (size_t i = 0; i < KNumEvents; ++i) {
+      struct {
+        uint64_t value;
+        uint64_t time_enabled;
+        uint64_t time_running;
+      } reading = {};
+      if (fds_[i] == -1 || read(fds_[i], &reading, sizeof(reading)) != sizeof(reading)) {
+        counts[i] = -1;
+        continue;
+      }
+      counts[i] = reading.time_running == 0
+                      ? 0
+                      : static_cast<int64_t>(
+                            static_cast<long double>(reading.value) * reading.time_enabled /
+                            reading.time_running
+                        );
+    }
+    return counts;
+  }
+
+private:
+  std::array<int, KNumEvents> fds_{};
+
+  void Open(PerfEvent event, uint32_t type, uint64_t config) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // Count the cache's syscalls too, unless only user space may be profiled
+    int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    if (fd == -1 && (errno == EACCES || errno == EPERM)) {
+      attr.exclude_kernel = 1;
+      fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+    fds_[static_cast<size_t>(event)] = fd;
+  }
+};
+
+}  // namespace lab1
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "lab1/IoLatReadCacheBench.hpp"
+#include "lab1/PerfCounters.hpp"
+#include "lab2/Api.hpp"
+
+namespace lab1 {
+
+// Measurements of the scaling benchmark at one thread count.
+struct ScalingResult {
+  unsigned threads{};
+  double ops_per_sec{};
+  uint64_t p50_ns{};
+  uint64_t p99_ns{};
+  uint64_t p999_ns{};
+  // Events per operation, summed over the threads. Negative if unavailable.
+  std::array<double, PerfCounters::KNumEvents> per_op{};
+};
+
+// Measurements of one benchmark thread.
+struct ScalingWorkerResult {
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point end;
+  std::vector<uint64_t> latencies_ns;
+  std::array<int64_t, PerfCounters::KNumEvents> counters{};
+};
+
+// CPUs the process may run on, the threads are pinned to them in turn.
+inline std::vector<int> AllowedCpus() {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::vector<int> cpus;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  if (cpus.empty()) {
+    cpus.push_back(0);
+  }
+  return cpus;
+}
+
+// Thread counts swept by the benchmark: powers of two up to max_threads, and
+// max_threads itself.
+inline std::vector<unsigned> ScalingThreadCounts(unsigned max_threads) {
+  std::vector<unsigned> counts;
+  for (unsigned threads = 1; threads < max_threads; threads *= 2) {
+    counts.push_back(threads);
+  }
+  counts.push_back(std::max(1U, max_threads));
+  return counts;
+}
+
+// Random KBenchBlockSize reads through the cache, timing each one.
+inline void ScalingWorker(
+    int cpu,
+    int iterations,
+    std::barrier<>& start,
+    ScalingWorkerResult& result
+) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+  const auto file = lab2_open(KTestFileName);
+  if (file < 0) {
+    perror("lab2_open");
+    std::quick_exit(EXIT_FAILURE);
+  }
+  const auto file_size = lab2_lseek(file, 0, SEEK_END);
+  if (file_size == static_cast<off_t>(-1)) {
+    perror("lab2_lseek");
+    std::quick_exit(EXIT_FAILURE);
+  }
+  const auto num_blocks = static_cast<size_t>(file_size) / KBenchBlockSize;
+
+  std::mt19937 engine(cpu);
+  std::uniform_int_distribution<size_t> dist(0, num_blocks - 1);
+  std::array<char, KBenchBlockSize> buffer{};
+  result.latencies_ns.reserve(iterations);
+  PerfCounters counters;
+
+  start.arrive_and_wait();
+  result.begin = std::chrono::steady_clock::now();
+  counters.Start();
+  for (int i = 0; i < iterations; ++i) {
+    const auto offset = static_cast<off_t>(dist(engine) * KBenchBlockSize);
+    const auto op_begin = std::chrono::steady_clock::now();
+    if (lab2_lseek(file, offset, SEEK_SET) == static_cast<off_t>(-1) ||
+        lab2_read(file, buffer.data(), KBenchBlockSize) != static_cast<ssize_t>(KBenchBlockSize)) {
+      perror("lab2_read");
+      std::quick_exit(EXIT_FAILURE);
+    }
+    const auto op_end = std::chrono::steady_clock::now();
+    result.latencies_ns.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(op_end - op_begin).count()
+    );
+    benchmark::DoNotOptimize(buffer);
+  }
+  counters.Stop();
+  result.end = std::chrono::steady_clock::now();
+  result.counters = counters.Read();
+
+  lab2_close(file);
+}
+
+inline uint64_t Percentile(std::vector<uint64_t>& values, double fraction) {
+  if (values.empty()) {
+    return 0;
+  }
+  auto nth = values.begin() + static_cast<ptrdiff_t>(fraction * (values.size() - 1));
+  std::nth_element(values.begin(), nth, values.end());
+  return *nth;
+}
+
+// Runs iterations reads on each of threads pinned threads at once.
+inline ScalingResult RunScalingPoint(unsigned threads, int iterations) {
+  const std::vector<int> cpus = AllowedCpus();
+  std::vector<ScalingWorkerResult> workers(threads);
+  std::barrier<> start(threads);
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < threads; ++i) {
+    pool.emplace_back(
+        ScalingWorker, cpus[i % cpus.size()], iterations, std::ref(start), std::ref(workers[i])
+    );
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  ScalingResult result;
+  result.threads = threads;
+  std::vector<uint64_t> latencies;
+  auto begin = workers[0].begin;
+  auto end = workers[0].end;
+  std::array<int64_t, PerfCounters::KNumEvents> totals{};
+  for (const auto& worker : workers) {
+    begin = std::min(begin, worker.begin);
+    end = std::max(end, worker.end);
+    latencies.insert(latencies.end(), worker.latencies_ns.begin(), worker.latencies_ns.end());
+    for (size_t i = 0; i < totals.size(); ++i) {
+      totals[i] = totals[i] < 0 || worker.counters[i] < 0 ? -1 : totals[i] + worker.counters[i];
+    }
+  }
+
+  const auto ops = static_cast<double>(latencies.size());
+  const double seconds = std::chrono::duration<double>(end - begin).count();
+  result.ops_per_sec = seconds > 0 ? ops / seconds : 0;
+  result.p50_ns = Percentile(latencies, 0.5);
+  result.p99_ns = Percentile(latencies, 0.99);
+  result.p999_ns = Percentile(latencies, 0.999);
+  for (size_t i = 0; i < totals.size(); ++i) {
+    result.per_op[i] = totals[i] < 0 || ops == 0 ? -1 : static_cast<double>(totals[i]) / ops;
+  }
+  return result;
+}
+
+inline void PrintScalingResults(const std::vector<ScalingResult>& results, bool csv) {
+  if (csv) {
+    std::printf(
+        "threads,ops_per_sec,p50_ns,p99_ns,p999_ns,cycles_per_op,instructions_per_op,"
+        "llc_misses_per_op,context_switches_per_op\n"
+    );
+  } else {
+    std::printf(
+        "%7s %12s %9s %9s %9s %11s %11s %11s %11s\n",
+        "threads",
+        "ops/s",
+        "p50 ns",
+        "p99 ns",
+        "p99.9 ns",
+        "cycles/op",
+        "instr/op",
+        "llc-miss/op",
+        "ctx-sw/op"
+    );
+  }
+
+  for (const auto& result : results) {
+    std::printf(
+        csv ? "%u,%.0f,%lu,%lu,%lu" : "%7u %12.0f %9lu %9lu %9lu",
+        result.threads,
+        result.ops_per_sec,
+        static_cast<unsigned long>(result.p50_ns),
+        static_cast<unsigned long>(result.p99_ns),
+        static_cast<unsigned long>(result.p999_ns)
+    );
+    for (const double per_op : result.per_op) {
+      if (per_op < 0 && csv) {
+        std::printf(",");
+      } else if (per_op < 0) {
+        std::printf(" %11s", "n/a");
+      } else {
+        std::printf(csv ? ",%.3f" : " %11.3f", per_op);
+      }
+    }
+    std::printf("\n");
+  }
+}
+
+// Sweeps the thread count up to max_threads, reporting throughput, latency
+// percentiles and perf counters per operation at each step. Poor scaling
+// shows up as flat ops/s with growing cycles and context switches per op,
+// the signature of threads queueing on the cache lock.
+inline void ScalingBenchmark(int iterations, unsigned max_threads, bool csv) {
+  GenerateTestFileCache();
+
+  std::vector<ScalingResult> results;
+  for (const unsigned threads : ScalingThreadCounts(max_threads)) {
+    results.push_back(RunScalingPoint(threads, iterations));
+  }
+  PrintScalingResults(results, csv);
+}
+
+}  // namespace lab1
@@ -1,13 +1,16 @@
 #include <pthread.h>  // Include pthread library
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <string>
 #include <thread>  // C++11 thread library for std::thread::hardware_concurrency()
 #include <vector>
 
+#include "lab1/BlockSizeBench.hpp"
 #include "lab1/IoLatReadCacheBench.hpp"
 #include "lab1/IoLatReadBench.hpp"
+#include "lab1/ScalingBench.hpp"
 
 namespace lab1::app {
 
@@ -38,7 +41,23 @@ void* RunBenchmark(void* arg) {
 
 void Main(int argc, const std::vector<std::string>& args) {
   if (argc < 3) {
-    std::cerr << "Usage: " << args[0] << " cache <iterations>\n";
+    std::cerr << "Usage: " << args[0] << " cache <iterations>\n"
+              << "       " << args[0] << " scaling <iterations> [max_threads] [csv]\n"
+              << "       " << args[0] << " blocksize <iterations> [csv]\n";
+    return;
+  }
+
+  if (args[1] == "scaling") {
+    // Sweeps thread counts, see ScalingBenchmark
+    const unsigned max_threads =
+        argc > 3 ? std::stoul(args[3]) : std::max(1U, std::thread::hardware_concurrency());
+    ScalingBenchmark(std::stoi(args[2]), max_threads, argc > 4 && args[4] == "csv");
+    return;
+  }
+
+  if (args[1] == "blocksize") {
+    // Compares the cache's block sizes, see BlockSizeBenchmark
+    BlockSizeBenchmark(std::stoi(args[2]), argc > 3 && args[3] == "csv");
     return;
   }
 
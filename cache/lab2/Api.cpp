@@ -1,36 +1,191 @@
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
 
 #include "./Cache.hpp"
+#include "./Trace.hpp"
 
-static lab2::FIFOCache cache(1024);
+namespace {
+
+// Memory of the cache, whatever its block size.
+constexpr size_t KCacheBytes = 1024 * KBlockSize;
+
+// Features backed by a file or a shared memory object, whose creation throws
+// if it is unavailable.
+struct ExternalFeature {
+  const char* name;
+  bool (*enabled)(const lab2::CacheOptions& options);
+  void (*disable)(lab2::CacheOptions& options);
+};
+
+constexpr ExternalFeature KExternalFeatures[] = {
+    {
+        "victim cache",
+        [](const lab2::CacheOptions& options) { return !options.victim_cache_path.empty(); },
+        [](lab2::CacheOptions& options) { options.victim_cache_path.clear(); },
+    },
+    {
+        "shared tier",
+        [](const lab2::CacheOptions& options) { return !options.shared_tier_name.empty(); },
+        [](lab2::CacheOptions& options) { options.shared_tier_name.clear(); },
+    },
+    {
+        "journal",
+        [](const lab2::CacheOptions& options) { return !options.journal_path.empty(); },
+        [](lab2::CacheOptions& options) { options.journal_path.clear(); },
+    },
+};
+
+// Creates the cache with the block size set in LAB2_BLOCK_SIZE, or
+// KBlockSize if it is unset or not one of KBlockSizes. Runs during static
+// initialization, before main of any program linking the library or
+// preloading the shim, so a feature that fails to start is reported and left
+// out rather than thrown.
+std::unique_ptr<lab2::PageCache> CreateApiCache() {
+  size_t block_size = KBlockSize;
+  if (const char* value = std::getenv("LAB2_BLOCK_SIZE")) {
+    const size_t requested = std::strtoull(value, nullptr, 10);
+    if (std::find(lab2::KBlockSizes.begin(), lab2::KBlockSizes.end(), requested) !=
+        lab2::KBlockSizes.end()) {
+      block_size = requested;
+    }
+  }
+  const size_t capacity = KCacheBytes / block_size;
+
+  lab2::CacheOptions options = lab2::CacheOptions::FromEnv();
+  try {
+    return lab2::CreateCache(block_size, capacity, options);
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "lab2: %s\n", error.what());
+  }
+
+  // Without each enabled feature in turn, then without all of them
+  for (const auto& feature : KExternalFeatures) {
+    if (!feature.enabled(options)) {
+      continue;
+    }
+    lab2::CacheOptions fallback = options;
+    feature.disable(fallback);
+    try {
+      auto api_cache = lab2::CreateCache(block_size, capacity, fallback);
+      std::fprintf(stderr, "lab2: continuing without the %s\n", feature.name);
+      return api_cache;
+    } catch (const std::exception&) {
+      // Another feature fails as well
+    }
+  }
+  for (const auto& feature : KExternalFeatures) {
+    feature.disable(options);
+  }
+  std::fprintf(stderr, "lab2: continuing without the victim cache, shared tier and journal\n");
+  return lab2::CreateCache(block_size, capacity, options);
+}
+
+}  // namespace
+
+static const std::unique_ptr<lab2::PageCache> cache = CreateApiCache();
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 int lab2_open(const char* path) {
-  return cache.OpenFile(path);
+  return cache->OpenFile(path);
+}
+
+int lab2_open_ex(const char* path, const struct lab2_open_options* options) {
+  return cache->OpenFile(path, options);
 }
 
 int lab2_close(int fd) {
-  return cache.CloseFile(fd);
+  return cache->CloseFile(fd);
 }
 
 ssize_t lab2_read(int fd, void* buf, size_t count) {
-  return cache.ReadFile(fd, static_cast<char*>(buf), count);
+  return cache->ReadFile(fd, static_cast<char*>(buf), count);
 }
 
 ssize_t lab2_write(int fd, const void* buf, size_t count) {
-  return cache.WriteFile(fd, static_cast<const char*>(buf), count);
+  return cache->WriteFile(fd, static_cast<const char*>(buf), count);
+}
+
+ssize_t lab2_pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  return cache->PWriteFile(fd, static_cast<const char*>(buf), count, offset);
 }
+
 off_t lab2_lseek(int fd, off_t offset, int whence) {
-  return cache.LSeek(fd, offset, whence);
+  return cache->LSeek(fd, offset, whence);
+}
+
+int lab2_set_write_mode(int fd, int mode) {
+  return cache->SetWriteMode(fd, mode);
 }
 
 int lab2_fsync(int fd) {
-  return cache.SyncFile(fd);
+  return cache->SyncFile(fd);
+}
+
+int lab2_ftruncate(int fd, off_t length) {
+  return cache->TruncateFile(fd, length);
+}
+
+int lab2_fstat(int fd, struct stat* st) {
+  return cache->StatFile(fd, st);
+}
+
+int lab2_create_partition(const char* name, size_t min_percent, size_t max_percent) {
+  if (name == nullptr) {
+    return -1;
+  }
+  return cache->CreatePartition(name, min_percent, max_percent);
+}
+
+int lab2_get_partition_stats(const char* name, struct lab2_partition_stats* stats) {
+  if (name == nullptr || stats == nullptr) {
+    return -1;
+  }
+  for (const auto& partition : cache->GetStats().partitions) {
+    if (partition.name == name) {
+      *stats = {
+          partition.blocks,
+          partition.min_blocks,
+          partition.max_blocks,
+          partition.hits,
+          partition.misses,
+          partition.evictions,
+      };
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int lab2_pin_range(int fd, off_t offset, size_t len) {
+  return cache->PinRange(fd, offset, len);
+}
+
+int lab2_unpin_range(int fd, off_t offset, size_t len) {
+  return cache->UnpinRange(fd, offset, len);
+}
+
+int lab2_set_range_priority(int fd, off_t offset, size_t len, int priority) {
+  return cache->SetRangePriority(fd, offset, len, priority);
+}
+
+ssize_t lab2_trace_dump(const char* path) {
+  if (path == nullptr) {
+    return -1;
+  }
+  return lab2::WriteChromeTrace(path);
+}
+
+ssize_t lab2_read_batch(struct lab2_read_req* reqs, size_t count) {
+  return cache->ReadBatch(reqs, count);
 }
 
 #ifdef __cplusplus
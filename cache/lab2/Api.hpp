@@ -1,3 +1,6 @@
+#pragma once
+
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <cstddef>
@@ -6,13 +9,106 @@
 extern "C" {
 #endif
 
+// A single positional read inside a lab2_read_batch call.
+struct lab2_read_req {
+  int fd;
+  off_t offset;
+  size_t len;
+  void* buf;
+  // Filled in by lab2_read_batch: bytes read, or -1 on error.
+  ssize_t result;
+};
+
+// How writes to a file reach the cache and the disk.
+enum lab2_write_mode {
+  // Writes dirty the cached blocks, written to disk on eviction or fsync.
+  LAB2_WRITE_BACK = 0,
+  // Writes update the cached blocks and the disk before returning, leaving
+  // the blocks clean.
+  LAB2_WRITE_THROUGH = 1,
+  // Writes go to the disk without loading the blocks into the cache. Blocks
+  // already cached are updated and written through.
+  LAB2_WRITE_AROUND = 2,
+};
+
+// Options of lab2_open_ex. Zero-initialize for the defaults.
+struct lab2_open_options {
+  // Cache partition charged for the file's blocks, NULL for the default one.
+  const char* partition;
+  // lab2_write_mode of the file, write-back by default.
+  int write_mode;
+};
+
+// Eviction priority classes. Lower classes are evicted first, so that blocks
+// of a higher class survive scans of lower ones.
+enum lab2_priority {
+  LAB2_PRIORITY_LOW = 0,
+  LAB2_PRIORITY_NORMAL = 1,
+  LAB2_PRIORITY_HIGH = 2,
+};
+
+// Counters of a cache partition, filled in by lab2_get_partition_stats.
+struct lab2_partition_stats {
+  size_t blocks;      // Resident blocks
+  size_t min_blocks;  // Guaranteed share of the capacity
+  size_t max_blocks;  // Largest share, reachable by borrowing idle capacity
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+};
+
 int lab2_open(const char* path);
+int lab2_open_ex(const char* path, const struct lab2_open_options* options);
 int lab2_close(int fd);
 ssize_t lab2_read(int fd, void* buf, size_t count);
 ssize_t lab2_write(int fd, const void* buf, size_t count);
+
+// Writes at offset without moving the file position, like pwrite. Positional
+// reads are served by lab2_read_batch.
+ssize_t lab2_pwrite(int fd, const void* buf, size_t count, off_t offset);
+
 off_t lab2_lseek(int fd, off_t offset, int whence);
+
+// Sets the lab2_write_mode of later writes to the file.
+int lab2_set_write_mode(int fd, int mode);
+
 int lab2_fsync(int fd);
 
+// Sets the file size as seen through the cache, like ftruncate.
+int lab2_ftruncate(int fd, off_t length);
+
+// Like fstat, with st_size including writes still held in the cache.
+int lab2_fstat(int fd, struct stat* st);
+
+// Creates a named cache partition guaranteed min_percent of the capacity and
+// allowed to grow up to max_percent while other partitions leave it idle.
+// The guarantees of all partitions add up to 100% at most.
+int lab2_create_partition(const char* name, size_t min_percent, size_t max_percent);
+
+int lab2_get_partition_stats(const char* name, struct lab2_partition_stats* stats);
+
+// Loads the blocks covering [offset, offset + len) and keeps them in the cache
+// until they are unpinned or the file is closed. Fails without pinning
+// anything if the pinned blocks would exceed their share of the capacity.
+int lab2_pin_range(int fd, off_t offset, size_t len);
+int lab2_unpin_range(int fd, off_t offset, size_t len);
+
+// Sets the lab2_priority class of the blocks covering [offset, offset + len),
+// both cached ones and ones loaded later.
+int lab2_set_range_priority(int fd, off_t offset, size_t len, int priority);
+
+// Writes the events recorded by the cache's trace points to path, in the
+// Chrome trace event format opened by chrome://tracing and Perfetto. Trace
+// points are compiled in only with LAB2_TRACE (CMake option lab2_TRACE).
+// Returns the number of events written, or -1 on error.
+ssize_t lab2_trace_dump(const char* path);
+
+// Serves many positional reads in a constant number of cache lock
+// acquisitions, however many hits and misses they have. The missing blocks
+// are read from disk in parallel, without holding the lock.
+// Returns the number of requests that completed without error.
+ssize_t lab2_read_batch(struct lab2_read_req* reqs, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
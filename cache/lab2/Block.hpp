@@ -3,12 +3,17 @@
 #include <sys/types.h>
 
 #include <cstddef>
+#include <cstdint>
 #include <list>
+#include <memory>
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "./Api.hpp"
+
 template <typename T, size_t Alignment>
 class aligned_allocator : public std::allocator<T> {
 public:
@@ -37,21 +42,55 @@ public:
   }
 };
 
+// Default block size of the cache, see BasicFIFOCache for the others.
 static constexpr size_t KBlockSize = 4096;
 static constexpr size_t KFdOffset = 32;
+// Alignment of block frames, as O_DIRECT requires whatever the block size.
+static constexpr size_t KFrameAlignment = 4096;
 
-using AlignedVec = std::vector<char, aligned_allocator<char, KBlockSize>>;
+using AlignedVec = std::vector<char, aligned_allocator<char, KFrameAlignment>>;
 
 struct Block {
   // Unique identifier for the block (e.g., (fd << 32) |
   // block_num)
   uint64_t block_id;
-  // Data contained in the block
+  // Data contained in the block, empty while the block uses a shared frame
   AlignedVec data;
   // Flag indicating if the block has been modified
   bool is_dirty;
+  // Committed to the journal but not yet written to its home location
+  bool is_journaled = false;
+  // Sequence number of the commit that journaled the block
+  int64_t journal_sequence = 0;
+  // Index of the cache partition the block is charged to
+  uint32_t partition = 0;
+  // Eviction priority class (lab2_priority), lower classes are evicted first
+  uint8_t priority = LAB2_PRIORITY_NORMAL;
+  // Kept in the cache by lab2_pin_range, never evicted
+  bool pinned = false;
+  // Position in its partition's eviction queue, while unpinned
+  std::list<Block*>::iterator queue_it;
+  // Read-only frame holding the contents when they are shared with other
+  // blocks (all-zero or deduplicated blocks). Must be made private before
+  // modification.
+  std::shared_ptr<const AlignedVec> shared;
+  // Content hash under which the shared frame is deduplicated, if it is
+  uint64_t shared_hash = 0;
 
   Block(uint64_t id, const AlignedVec& data_vec, bool dirty = false)
       : block_id(id), data(data_vec.begin(), data_vec.end()), is_dirty(dirty) {
   }
+
+  Block(uint64_t id, std::shared_ptr<const AlignedVec> frame, uint64_t hash)
+      : block_id(id), is_dirty(false), shared(std::move(frame)), shared_hash(hash) {
+  }
+
+  // Contents of the block, whether private or shared
+  const char* Data() const {
+    return shared ? shared->data() : data.data();
+  }
+
+  size_t Size() const {
+    return shared ? shared->size() : data.size();
+  }
 };
\ No newline at end of file
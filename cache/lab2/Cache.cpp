@@ -6,32 +6,146 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "./Frame.hpp"
+#include "./ThreadCache.hpp"
+#include "./Trace.hpp"
+
 namespace lab2 {
 
-FIFOCache::FIFOCache(size_t capacity) : capacity_(capacity) {
+namespace {
+
+std::atomic<uint64_t> next_cache_id{1};
+
+// Number of the size bytes at position that lie before the logical end of the file.
+size_t BytesBeforeEof(const FileHandle& file, off_t position, size_t size) {
+  const off_t file_size = file.size.load(std::memory_order_acquire);
+  if (position >= file_size) {
+    return 0;
+  }
+  return std::min(size, static_cast<size_t>(file_size - position));
+}
+
+uint64_t ChangeTimeNs(const struct stat& stat_data) {
+  return static_cast<uint64_t>(stat_data.st_ctim.tv_sec) * 1000000000 +
+         static_cast<uint64_t>(stat_data.st_ctim.tv_nsec);
+}
+
+bool EnvFlag(const char* name) {
+  const char* value = std::getenv(name);
+  return value != nullptr && std::strcmp(value, "0") != 0 && *value != '\0';
+}
+
+}  // namespace
+
+CacheOptions CacheOptions::FromEnv() {
+  CacheOptions options;
+  options.thread_cache = EnvFlag("LAB2_THREAD_CACHE");
+  options.compressed_tier = EnvFlag("LAB2_COMPRESSED_TIER");
+  options.dedup_blocks = EnvFlag("LAB2_DEDUP");
+  options.read_bypass = EnvFlag("LAB2_READ_BYPASS");
+  if (const char* path = std::getenv("LAB2_VICTIM_CACHE_PATH")) {
+    options.victim_cache_path = path;
+  }
+  if (const char* blocks = std::getenv("LAB2_VICTIM_CACHE_BLOCKS")) {
+    options.victim_cache_blocks = std::strtoull(blocks, nullptr, 10);
+  }
+  if (const char* name = std::getenv("LAB2_SHARED_TIER_NAME")) {
+    options.shared_tier_name = name;
+  }
+  if (const char* blocks = std::getenv("LAB2_SHARED_TIER_BLOCKS")) {
+    options.shared_tier_blocks = std::strtoull(blocks, nullptr, 10);
+  }
+  if (const char* path = std::getenv("LAB2_JOURNAL_PATH")) {
+    options.journal_path = path;
+  }
+  if (const char* percent = std::getenv("LAB2_MAX_PINNED_PERCENT")) {
+    options.max_pinned_percent = std::strtoull(percent, nullptr, 10);
+  }
+  return options;
+}
+
+template <size_t BlockSize>
+BasicFIFOCache<BlockSize>::BasicFIFOCache(size_t capacity, const CacheOptions& options)
+    : capacity_(capacity)
+    , options_(options)
+    , id_(next_cache_id.fetch_add(1)) {
+  partitions_.push_back({KDefaultPartition, 0, 100});
+
+  if (options_.compressed_tier) {
+    // Start with two adaptation steps worth of capacity
+    compressed_frames_ =
+        std::min(MaxCompressedFrames(), 2 * std::max<size_t>(1, capacity_ / 16));
+    compressed_tier_ = std::make_unique<CompressedTier>(compressed_frames_ * BlockSize, BlockSize);
+  }
+
+  if (!options_.victim_cache_path.empty() && options_.victim_cache_blocks > 0) {
+    victim_cache_ = std::make_unique<VictimCache>(
+        options_.victim_cache_path, options_.victim_cache_blocks, BlockSize
+    );
+    if (compressed_tier_) {
+      compressed_tier_->SetEvictionHandler(
+          [this](uint64_t block_id, const char* data, size_t size) {
+            victim_cache_->Put(block_id, data, size);
+          }
+      );
+    }
+  }
+
+  if (!options_.shared_tier_name.empty() && options_.shared_tier_blocks > 0) {
+    shared_tier_ = std::make_unique<SharedTier>(
+        options_.shared_tier_name, options_.shared_tier_blocks, BlockSize
+    );
+  }
+
+  if (!options_.journal_path.empty()) {
+    journal_ = std::make_unique<Journal>(options_.journal_path, BlockSize);
+    if (journal_->Replay() == -1) {
+      throw std::runtime_error("Failed to replay journal " + options_.journal_path);
+    }
+    checkpointer_ = std::thread(&BasicFIFOCache::CheckpointLoop, this);
+  }
 }
 
-FIFOCache::~FIFOCache() {
+template <size_t BlockSize>
+BasicFIFOCache<BlockSize>::~BasicFIFOCache() {
+  if (checkpointer_.joinable()) {
+    {
+      const std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+      stop_checkpointer_ = true;
+    }
+    checkpoint_wanted_.notify_one();
+    checkpointer_.join();
+  }
+
   Flush();
   // Close all open file descriptors
-  for (auto& [user_fd, os_fd] : open_files_) {
-    close(os_fd);
+  for (auto& [user_fd, file] : open_files_) {
+    file->closed = true;
+    close(file->os_fd);
   }
 }
 
-void FIFOCache::Flush() {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::Flush() {
+  const auto lock = LockCache();
 
   for (auto& block : cache_list_) {
     if (block.is_dirty) {
@@ -42,25 +156,73 @@ void FIFOCache::Flush() {
       block.is_dirty = false;
     }
   }
+
+  for (auto& [user_fd, file] : open_files_) {
+    SyncFileSize(*file);
+  }
+
+  if (journal_) {
+    Checkpoint();
+  }
 }
 
-int FIFOCache::OpenFile(const std::string& path) {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::OpenFile(const std::string& path, const lab2_open_options* options) {
+  const auto lock = LockCache();
+
+  size_t partition = 0;
+  if (options != nullptr && options->partition != nullptr) {
+    auto partition_it =
+        std::find_if(partitions_.begin(), partitions_.end(), [options](const Partition& entry) {
+          return entry.name == options->partition;
+        });
+    if (partition_it == partitions_.end()) {
+      return -1;  // Unknown partition
+    }
+    partition = partition_it - partitions_.begin();
+  }
+  const int write_mode = options != nullptr ? options->write_mode : LAB2_WRITE_BACK;
+  if (write_mode < 0 || write_mode >= static_cast<int>(KNumWriteModes)) {
+    return -1;  // Unknown write mode
+  }
 
   const int os_fd = open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
   if (os_fd == -1) {
     return -1;
   }
 
+  // The only fstat of the file, its size is tracked in the cache from now on
+  struct stat stat_data = {};
+  if (fstat(os_fd, &stat_data) == -1) {
+    close(os_fd);
+    return -1;
+  }
+
+  auto file = std::make_shared<FileHandle>(os_fd, stat_data.st_size);
+  file->partition = partition;
+  file->write_mode = write_mode;
+  file->shared_key = {
+      static_cast<uint64_t>(stat_data.st_dev),
+      static_cast<uint64_t>(stat_data.st_ino),
+  };
+  if (shared_tier_) {
+    shared_tier_->OpenFile(file->shared_key, ChangeTimeNs(stat_data));
+  }
+  if (journal_) {
+    char* real_path = realpath(path.c_str(), nullptr);
+    file->path = real_path != nullptr ? real_path : path;
+    std::free(real_path);
+  }
+
   const int user_fd = next_fd_++;
-  open_files_[user_fd] = os_fd;
-  file_positions_[user_fd] = 0;
+  open_files_[user_fd] = std::move(file);
 
   return user_fd;
 }
 
-int FIFOCache::CloseFile(int fd) {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::CloseFile(int fd) {
+  const auto lock = LockCache();
 
   auto iter = open_files_.find(fd);
   if (iter == open_files_.end()) {
@@ -69,12 +231,14 @@ int FIFOCache::CloseFile(int fd) {
 
   // Flush all blocks related to this file
   for (auto block_it = cache_list_.begin(); block_it != cache_list_.end();) {
-    if ((block_it->block_id >> KFdOffset) == fd) {
-      if (block_it->is_dirty) {
+    if ((block_it->block_id >> KFdOffset) == static_cast<uint64_t>(fd)) {
+      if (block_it->is_dirty || block_it->is_journaled) {
         WriteBlockToDisk(*block_it);
       }
 
       const uint64_t block_id = block_it->block_id;
+      InvalidateThreadCaches(block_id);
+      ReleaseFrame(*block_it);
       map_.erase(block_id);
       block_it = cache_list_.erase(block_it);
 
@@ -83,57 +247,102 @@ int FIFOCache::CloseFile(int fd) {
     ++block_it;
   }
 
+  if (compressed_tier_) {
+    compressed_tier_->EraseFile(fd);
+  }
+  if (victim_cache_) {
+    victim_cache_->InvalidateFile(fd);
+  }
+
+  // Cut the whole-block writeback of the tail back to the logical size. In
+  // journal mode the file is synced too, as a checkpoint may drop its
+  // committed blocks from the journal once the file is closed.
+  bool synced = SyncFileSize(*iter->second) == 0;
+  if (journal_ && iter->second->home_unsynced && fsync(iter->second->os_fd) == -1) {
+    synced = false;
+  }
+
   // Close the OS file descriptor
-  if (close(iter->second) != 0) {
+  iter->second->closed = true;
+  if (close(iter->second->os_fd) != 0) {
     return -1;
   }
 
-  // Remove the file from open_files_ and file_positions_
+  // Remove the file from open_files_
   open_files_.erase(iter);
-  file_positions_.erase(fd);
 
-  return 0;
+  return synced ? 0 : -1;
 }
 
-ssize_t FIFOCache::ReadFile(int fd, char* buf, size_t size) {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::ReadFile(int fd, char* buf, size_t size) {
+  if (options_.thread_cache) {
+    const ssize_t bytes_read = ReadFromThreadCache(fd, buf, size);
+    if (bytes_read != -1) {
+      return bytes_read;
+    }
+  }
+
+  auto lock = LockCache();
 
   auto iter = open_files_.find(fd);
   if (iter == open_files_.end()) {
     return -1;  // Invalid file descriptor
   }
 
-  const int os_fd = iter->second;
-  off_t current_pos = file_positions_[fd];
+  const int os_fd = iter->second->os_fd;
+  off_t current_pos = iter->second->position;
+  const size_t size_to_read = BytesBeforeEof(*iter->second, current_pos, size);
   size_t bytes_read_total = 0;
 
-  while (bytes_read_total < size) {
-    const int block_num = current_pos / KBlockSize;
-    const size_t block_offset = current_pos % KBlockSize;
-    const size_t bytes_to_read = std::min(KBlockSize - block_offset, size - bytes_read_total);
+  if (options_.read_bypass) {
+    const size_t bypass_bytes = BypassBytes(*iter->second, current_pos, size_to_read);
+    if (bypass_bytes > 0) {
+      // Releases the lock meanwhile, which may invalidate iter
+      if (ReadDirect(lock, fd, iter->second, buf, current_pos, bypass_bytes) == -1) {
+        return -1;  // Read error, or closed meanwhile
+      }
+      iter = open_files_.find(fd);
+      bytes_read_total = bypass_bytes;
+      current_pos += static_cast<off_t>(bypass_bytes);
+    }
+  }
+
+  while (bytes_read_total < size_to_read) {
+    const int block_num = current_pos / BlockSize;
+    const size_t block_offset = current_pos % BlockSize;
+    const size_t bytes_to_read =
+        std::min(BlockSize - block_offset, size_to_read - bytes_read_total);
 
     // Create a unique block identifier, e.g., (fd << 32) | block_num
     const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | block_num;
 
     Block* block = GetBlock(block_id);
-    if (block == nullptr) {
-      // Load block from disk
-      AlignedVec block_data(KBlockSize, 0);
-      const ssize_t bytes_read =
-          pread(os_fd, block_data.data(), KBlockSize, block_num * KBlockSize);
-      if (bytes_read == -1) {
+    if (block != nullptr) {
+      CountAccess(block_id, true);
+    } else if (ReadShared(block_id, block_offset, buf + bytes_read_total, bytes_to_read)) {
+      bytes_read_total += bytes_to_read;
+      current_pos += bytes_to_read;
+      continue;
+    } else {
+      // Load block from the compressed tier or disk
+      AlignedVec block_data;
+      if (FetchBlock(os_fd, block_id, block_data) == -1) {
         return -1;  // Read error
       }
-      block_data.resize(bytes_read);
       block = LoadBlock(block_id, block_data);
       if (block == nullptr) {
         return -1;  // Failed to load block
       }
     }
 
+    if (options_.thread_cache) {
+      RememberInThreadCache(fd, iter->second, *block);
+    }
+
     // Copy data from block to buffer
-    const size_t copy_size = std::min(bytes_to_read, block->data.size() - block_offset);
-    std::memcpy(buf + bytes_read_total, block->data.data() + block_offset, copy_size);
+    const size_t copy_size = std::min(bytes_to_read, block->Size() - block_offset);
+    std::memcpy(buf + bytes_read_total, block->Data() + block_offset, copy_size);
     bytes_read_total += copy_size;
     current_pos += copy_size;
 
@@ -142,64 +351,44 @@ ssize_t FIFOCache::ReadFile(int fd, char* buf, size_t size) {
     }
   }
 
-  file_positions_[fd] = current_pos;
+  iter->second->position = current_pos;
   return bytes_read_total;
 }
 
-ssize_t FIFOCache::WriteFile(int fd, const char* buf, size_t size) {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::WriteFile(int fd, const char* buf, size_t size) {
+  const auto lock = LockCache();
 
   auto iter = open_files_.find(fd);
   if (iter == open_files_.end()) {
     return -1;  // Invalid file descriptor
   }
 
-  const int os_fd = iter->second;
-  off_t current_pos = file_positions_[fd];
-  size_t bytes_written_total = 0;
-
-  while (bytes_written_total < size) {
-    const int block_num = current_pos / KBlockSize;
-    const size_t block_offset = current_pos % KBlockSize;
-    const size_t bytes_to_write = std::min(KBlockSize - block_offset, size - bytes_written_total);
-
-    // Create a unique block identifier, e.g., (fd << 32) | block_num
-    const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | block_num;
-
-    Block* block = GetBlock(block_id);
-    if (block == nullptr) {
-      AlignedVec block_data(KBlockSize, 0);
-      const ssize_t bytes_read =
-          pread(os_fd, block_data.data(), KBlockSize, block_num * KBlockSize);
-      if (bytes_read == -1) {
-        return -1;  // Read error
-      }
-
-      PutBlock(block_id, block_data.data(), KBlockSize);
-      block = GetBlock(block_id);
-      if (block == nullptr) {
-        return -1;  // Failed to load block
-      }
-    }
+  const ssize_t bytes_written = WriteAt(fd, *iter->second, buf, size, iter->second->position);
+  if (bytes_written != -1) {
+    iter->second->position += bytes_written;
+  }
+  return bytes_written;
+}
 
-    // Ensure block size is sufficient
-    if (block->data.size() < block_offset + bytes_to_write) {
-      return -1;  // Invalid block size
-    }
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::PWriteFile(int fd, const char* buf, size_t size, off_t offset) {
+  const auto lock = LockCache();
 
-    // Write data from buffer to block
-    std::memcpy(block->data.data() + block_offset, buf + bytes_written_total, bytes_to_write);
-    block->is_dirty = true;
-    bytes_written_total += bytes_to_write;
-    current_pos += bytes_to_write;
+  auto iter = open_files_.find(fd);
+  if (iter == open_files_.end()) {
+    return -1;  // Invalid file descriptor
+  }
+  if (offset < 0) {
+    return -1;  // Invalid position
   }
 
-  file_positions_[fd] = current_pos;
-  return bytes_written_total;
+  return WriteAt(fd, *iter->second, buf, size, offset);
 }
 
-off_t FIFOCache::LSeek(int fd, off_t offset, int whence) {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+off_t BasicFIFOCache<BlockSize>::LSeek(int fd, off_t offset, int whence) {
+  const auto lock = LockCache();
 
   auto iter = open_files_.find(fd);
   if (iter == open_files_.end()) {
@@ -212,16 +401,11 @@ off_t FIFOCache::LSeek(int fd, off_t offset, int whence) {
       new_pos = offset;
       break;
     case SEEK_CUR:
-      new_pos = file_positions_[fd] + offset;
+      new_pos = iter->second->position + offset;
       break;
-    case SEEK_END: {
-      struct stat stat_data = {};
-      if (fstat(iter->second, &stat_data) == -1) {
-        return -1;  // fstat failed
-      }
-      new_pos = stat_data.st_size + offset;
+    case SEEK_END:
+      new_pos = iter->second->size + offset;
       break;
-    }
     default:
       return -1;  // Invalid 'whence'
   }
@@ -230,21 +414,43 @@ off_t FIFOCache::LSeek(int fd, off_t offset, int whence) {
     return -1;  // Invalid position
   }
 
-  file_positions_[fd] = new_pos;
+  iter->second->position = new_pos;
   return new_pos;
 }
 
-int FIFOCache::SyncFile(int fd) {
-  const std::unique_lock<std::shared_mutex> lock(cache_mutex_);
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::SetWriteMode(int fd, int mode) {
+  const auto lock = LockCache();
 
   auto iter = open_files_.find(fd);
   if (iter == open_files_.end()) {
     return -1;  // Invalid file descriptor
   }
+  if (mode < 0 || mode >= static_cast<int>(KNumWriteModes)) {
+    return -1;  // Unknown write mode
+  }
+
+  iter->second->write_mode = mode;
+  return 0;
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::SyncFile(int fd) {
+  LAB2_TRACE_SCOPE(Sync, fd);
+  auto lock = LockCache();
+
+  auto iter = open_files_.find(fd);
+  if (iter == open_files_.end()) {
+    return -1;  // Invalid file descriptor
+  }
+
+  if (journal_) {
+    return CommitToJournal(lock, fd, *iter->second);
+  }
 
   // Flush all dirty blocks related to this file
   for (auto& block : cache_list_) {
-    if ((block.block_id >> KFdOffset) == fd && block.is_dirty) {
+    if ((block.block_id >> KFdOffset) == static_cast<uint64_t>(fd) && block.is_dirty) {
       if (WriteBlockToDisk(block) == -1) {
         return -1;  // Write error
       }
@@ -252,95 +458,1507 @@ int FIFOCache::SyncFile(int fd) {
     }
   }
 
+  if (SyncFileSize(*iter->second) == -1) {
+    return -1;  // ftruncate failed
+  }
+
   // Sync the OS file descriptor
-  if (fsync(iter->second) == -1) {
+  if (fsync(iter->second->os_fd) == -1) {
     return -1;  // fsync failed
   }
 
   return 0;  // Success
 }
 
-// Private Methods
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::TruncateFile(int fd, off_t length) {
+  const auto lock = LockCache();
 
-Block* FIFOCache::GetBlock(uint64_t block_id) {
-  auto map_it = map_.find(block_id);
-  if (map_it == map_.end()) {
-    return nullptr;
+  auto iter = open_files_.find(fd);
+  if (iter == open_files_.end()) {
+    return -1;  // Invalid file descriptor
+  }
+  if (length < 0) {
+    return -1;  // Invalid length
   }
 
-  // В FIFO порядок доступа не изменяется.
-  return &(*(map_it->second));
-}
+  // Replay of an older commit must not restore the size it had
+  FileHandle& file = *iter->second;
+  if (journal_ && committed_paths_.contains(file.path)) {
+    const int64_t sequence = journal_->Commit(file.path, {}, length);
+    if (sequence == -1 || journal_->WaitDurable(sequence) == -1) {
+      return -1;  // Journal write error
+    }
+  }
+  if (ftruncate(file.os_fd, length) == -1) {
+    return -1;  // ftruncate failed
+  }
+  file.disk_size = length;
+  UpdateSharedFile(file);
+
+  if (length < file.size) {
+    // Drop the blocks past the new end and zero the rest of the last block,
+    // which must read back as zeros if the file grows again
+    const uint64_t end_block = (length + BlockSize - 1) / BlockSize;
+    const size_t tail = length % BlockSize;
+    for (auto block_it = cache_list_.begin(); block_it != cache_list_.end();) {
+      const uint64_t block_id = block_it->block_id;
+      const uint64_t block_num = block_id & 0xFFFFFFFF;
+      if ((block_id >> KFdOffset) != static_cast<uint64_t>(fd) || block_num + 1 < end_block) {
+        ++block_it;
+        continue;
+      }
 
-void FIFOCache::PutBlock(uint64_t block_id, const char* block_data, size_t data_size) {
-  auto it = map_.find(block_id);
-  if (it != map_.end()) {
-    Block& block = *(it->second);
-    block.data.assign(block_data, block_data + data_size);
-    block.is_dirty = true;
-    // В FIFO порядок не обновляем, поэтому не вызываем Touch.
-  } else {
-    // Block not in cache, need to add it
-    if (cache_list_.size() >= capacity_) {
-      EvictIfNeeded();
+      // A background checkpoint must not write the old contents back
+      SupersedeCheckpointWrite(block_id);
+      if (block_num >= end_block) {
+        InvalidateThreadCaches(block_id);
+        ReleaseFrame(*block_it);
+        map_.erase(block_id);
+        block_it = cache_list_.erase(block_it);
+        continue;
+      }
+
+      if (tail != 0) {
+        MakePrivate(*block_it);
+        std::memset(block_it->data.data() + tail, 0, BlockSize - tail);
+        InvalidateCopies(block_id);
+        ShareIfZero(*block_it);
+      }
+      ++block_it;
     }
 
-    // Для FIFO вставляем новый блок в конец списка
-    cache_list_.emplace_back(block_id, AlignedVec(data_size));
-    auto new_it = std::prev(cache_list_.end());
-    new_it->data.assign(block_data, block_data + data_size);
-    new_it->is_dirty = true;
-    map_[block_id] = new_it;
+    // The lower tiers may hold blocks past the new end as well
+    if (compressed_tier_) {
+      compressed_tier_->EraseFile(fd);
+    }
+    if (victim_cache_) {
+      victim_cache_->InvalidateFile(fd);
+    }
+    if (shared_tier_) {
+      shared_tier_->EraseFrom(file.shared_key, length / BlockSize);
+    }
   }
+
+  file.size = length;
+  return 0;
 }
 
-Block* FIFOCache::LoadBlock(uint64_t block_id, const AlignedVec& data) {
-  // Evict if cache is full
-  EvictIfNeeded();
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::StatFile(int fd, struct stat* st) {
+  const auto lock = LockCache();
 
-  // Для FIFO вставляем новый блок в конец списка
-  cache_list_.emplace_back(block_id, data, false);
-  auto new_it = std::prev(cache_list_.end());
-  map_[block_id] = new_it;
-  return &(*new_it);
+  auto iter = open_files_.find(fd);
+  if (iter == open_files_.end() || st == nullptr) {
+    return -1;  // Invalid file descriptor
+  }
+
+  if (fstat(iter->second->os_fd, st) == -1) {
+    return -1;  // fstat failed
+  }
+  st->st_size = iter->second->size;
+  return 0;
 }
 
-void FIFOCache::EvictIfNeeded() {
-  if (cache_list_.size() < capacity_) {
-    return;
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::ReadBatch(lab2_read_req* reqs, size_t count) {
+  if (reqs == nullptr && count != 0) {
+    return -1;
   }
 
-  // Для FIFO эвиктируем самый старый блок (находящийся в начале списка)
-  Block& block_to_evict = cache_list_.front();
-  if (block_to_evict.is_dirty) {
-    WriteBlockToDisk(block_to_evict);
+  auto lock = LockCache();
+
+  // Collect every block touched by the batch, sorted and deduplicated
+  std::vector<uint64_t> block_ids;
+  std::vector<size_t> lengths(count);  // Request lengths, cut at the end of the file
+  for (size_t i = 0; i < count; ++i) {
+    lab2_read_req& req = reqs[i];
+    req.result = -1;
+    if (!open_files_.contains(req.fd) || req.offset < 0 || (req.buf == nullptr && req.len != 0)) {
+      continue;  // Invalid request
+    }
+    req.result = 0;
+    lengths[i] = BytesBeforeEof(*open_files_[req.fd], req.offset, req.len);
+    if (lengths[i] == 0) {
+      continue;
+    }
+
+    const uint64_t first_block = req.offset / BlockSize;
+    const uint64_t last_block = (req.offset + lengths[i] - 1) / BlockSize;
+    for (uint64_t block_num = first_block; block_num <= last_block; ++block_num) {
+      block_ids.push_back((static_cast<uint64_t>(req.fd) << KFdOffset) | block_num);
+    }
   }
+  std::sort(block_ids.begin(), block_ids.end());
+  block_ids.erase(std::unique(block_ids.begin(), block_ids.end()), block_ids.end());
+
+  // Group the misses into runs of adjacent blocks. Hits are resolved once the
+  // misses are read, as the lock is released meanwhile.
+  struct Run {
+    std::shared_ptr<FileHandle> file;
+    uint64_t first_block_id;
+    size_t num_blocks;
+    AlignedVec buffer;
+    ssize_t bytes_read;
+  };
+  std::unordered_map<uint64_t, uint64_t> versions;  // Of the misses, when they were looked up
+  std::vector<std::pair<uint64_t, AlignedVec>> recovered;  // Misses found in lower tiers
+  std::unordered_set<uint64_t> shared_served;  // Served by the shared tier, never admitted
+  std::vector<Run> runs;
+  std::unordered_map<uint64_t, uint64_t> fill_tokens;  // Shared tier fill tokens of the misses
+  for (const uint64_t block_id : block_ids) {
+    if (GetBlock(block_id) != nullptr) {
+      continue;
+    }
 
-  map_.erase(block_to_evict.block_id);
-  cache_list_.pop_front();
+    CountAccess(block_id, false);
+    versions[block_id] = BlockVersion(block_id).load(std::memory_order_acquire);
+    AlignedVec block_data;
+    if (shared_tier_ &&
+        shared_tier_->Get(SharedKeyOf(block_id), block_id & 0xFFFFFFFF, block_data)) {
+      ++shared_hits_;
+      shared_served.insert(block_id);
+      recovered.emplace_back(block_id, std::move(block_data));
+      continue;
+    }
+    if (FetchFromLowerTiers(block_id, block_data)) {
+      recovered.emplace_back(block_id, std::move(block_data));
+      continue;
+    }
+
+    if (!runs.empty()) {
+      Run& last = runs.back();
+      const uint64_t next_id = last.first_block_id + last.num_blocks;
+      if (next_id == block_id && (next_id >> KFdOffset) == (block_id >> KFdOffset) &&
+          last.num_blocks < KMaxBatchRunBlocks) {
+        ++last.num_blocks;
+        continue;
+      }
+    }
+    const int fd = static_cast<int>(block_id >> KFdOffset);
+    runs.push_back({open_files_[fd], block_id, 1, AlignedVec(), 0});
+  }
+  // Taken before the reads, so that a block rewritten meanwhile is not filled stale
+  if (shared_tier_) {
+    for (const Run& run : runs) {
+      for (size_t i = 0; i < run.num_blocks; ++i) {
+        const uint64_t block_id = run.first_block_id + i;
+        fill_tokens[block_id] =
+            shared_tier_->FillToken(SharedKeyOf(block_id), block_id & 0xFFFFFFFF);
+      }
+    }
+  }
+  if (runs.size() > 1 && !io_pool_) {
+    io_pool_ = std::make_unique<IoPool>(KMaxBatchIoThreads - 1);
+  }
+  IoPool* io_pool = io_pool_.get();
+
+  // Issue the merged misses with the lock released, in parallel when there is
+  // more than one run
+  lock.unlock();
+  auto read_run = [&runs](size_t i) {
+    Run& run = runs[i];
+    run.buffer.resize(run.num_blocks * BlockSize);
+    const off_t offset = static_cast<off_t>(run.first_block_id & 0xFFFFFFFF) * BlockSize;
+    run.bytes_read = pread(run.file->os_fd, run.buffer.data(), run.buffer.size(), offset);
+  };
+  if (runs.size() > 1) {
+    io_pool->Run(runs.size(), read_run);
+  } else if (runs.size() == 1) {
+    read_run(0);
+  }
+  lock.lock();
+
+  std::unordered_map<uint64_t, std::pair<const char*, size_t>> read_frames;
+  std::unordered_set<int> failed_files;
+  for (const auto& [block_id, block_data] : recovered) {
+    read_frames[block_id] = {block_data.data(), block_data.size()};
+  }
+  for (const Run& run : runs) {
+    if (run.bytes_read == -1 || run.file->closed) {
+      failed_files.insert(static_cast<int>(run.first_block_id >> KFdOffset));
+      continue;
+    }
+    // Blocks past a short read keep the zeros the buffer was created with
+    for (size_t i = 0; i < run.num_blocks; ++i) {
+      const uint64_t block_id = run.first_block_id + i;
+      read_frames[block_id] = {run.buffer.data() + i * BlockSize, BlockSize};
+      if (shared_tier_) {
+        shared_tier_->Fill(
+            SharedKeyOf(block_id),
+            block_id & 0xFFFFFFFF,
+            read_frames[block_id].first,
+            fill_tokens[block_id]
+        );
+      }
+    }
+  }
+
+  // Blocks cached meanwhile are newer than the ones read. Blocks changed
+  // meanwhile, and hits evicted meanwhile, are fetched again.
+  std::unordered_map<uint64_t, std::pair<const char*, size_t>> frames;
+  std::vector<uint64_t> admitted;  // Resolved blocks that are not cached
+  std::vector<AlignedVec> fetched;
+  fetched.reserve(block_ids.size());
+  for (const uint64_t block_id : block_ids) {
+    const int fd = static_cast<int>(block_id >> KFdOffset);
+    auto file_it = open_files_.find(fd);
+    if (file_it == open_files_.end() || failed_files.contains(fd)) {
+      failed_files.insert(fd);
+      continue;  // Closed meanwhile, or a read error
+    }
+
+    const bool missed = versions.contains(block_id);
+    if (const Block* block = GetBlock(block_id)) {
+      if (!missed) {
+        CountAccess(block_id, true);
+      }
+      frames[block_id] = {block->Data(), block->Size()};
+      continue;
+    }
+
+    auto read_it = read_frames.find(block_id);
+    if (missed && read_it != read_frames.end() &&
+        BlockVersion(block_id).load(std::memory_order_acquire) == versions[block_id]) {
+      frames[block_id] = read_it->second;
+      if (!shared_served.contains(block_id)) {
+        admitted.push_back(block_id);
+      }
+      continue;
+    }
+
+    AlignedVec& block_data = fetched.emplace_back();
+    if (FetchBlock(file_it->second->os_fd, block_id, block_data) == -1) {
+      failed_files.insert(fd);
+      continue;  // Read error
+    }
+    frames[block_id] = {block_data.data(), block_data.size()};
+    admitted.push_back(block_id);
+  }
+
+  // Copy data into the callers' buffers
+  ssize_t succeeded = 0;
+  for (size_t i = 0; i < count; ++i) {
+    lab2_read_req& req = reqs[i];
+    if (req.result == -1) {
+      continue;
+    }
+
+    off_t current_pos = req.offset;
+    size_t bytes_read_total = 0;
+    while (bytes_read_total < lengths[i]) {
+      const uint64_t block_num = current_pos / BlockSize;
+      const size_t block_offset = current_pos % BlockSize;
+      const size_t bytes_to_read =
+          std::min(BlockSize - block_offset, lengths[i] - bytes_read_total);
+      const uint64_t block_id = (static_cast<uint64_t>(req.fd) << KFdOffset) | block_num;
+
+      auto frame_it = frames.find(block_id);
+      if (frame_it == frames.end()) {
+        break;  // Read error
+      }
+      const auto [data, data_size] = frame_it->second;
+      const size_t available = data_size > block_offset ? data_size - block_offset : 0;
+      const size_t copy_size = std::min(bytes_to_read, available);
+      if (copy_size > 0) {
+        std::memcpy(static_cast<char*>(req.buf) + bytes_read_total, data + block_offset, copy_size);
+      }
+      bytes_read_total += copy_size;
+      current_pos += static_cast<off_t>(copy_size);
+
+      if (copy_size < bytes_to_read) {
+        break;  // Reached EOF
+      }
+    }
+
+    if (failed_files.contains(req.fd) && bytes_read_total < lengths[i]) {
+      req.result = -1;
+      continue;  // Read error
+    }
+    req.result = static_cast<ssize_t>(bytes_read_total);
+    ++succeeded;
+  }
+
+  // Admit the missed blocks only after the copies, so that eviction caused by
+  // a large batch cannot drop frames still needed by it
+  for (const uint64_t block_id : admitted) {
+    const auto [data, data_size] = frames[block_id];
+    LoadBlock(block_id, AlignedVec(data, data + data_size));
+  }
+
+  return succeeded;
 }
 
-int FIFOCache::WriteBlockToDisk(Block& block) {
-  const int fd = block.block_id >> KFdOffset;
-  const int block_num = block.block_id & 0xFFFFFFFF;
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::PinRange(int fd, off_t offset, size_t len) {
+  const auto lock = LockCache();
 
   auto iter = open_files_.find(fd);
   if (iter == open_files_.end()) {
     return -1;  // Invalid file descriptor
   }
+  if (offset < 0) {
+    return -1;  // Invalid range
+  }
 
-  const ssize_t bytes_written = pwrite(
-      iter->second, block.data.data(), block.data.size(), static_cast<off_t>(block_num) * KBlockSize
-  );
-  if (bytes_written == -1) {
-    return -1;  // Write error
+  const uint64_t first_block = offset / BlockSize;
+  const uint64_t end_block = (offset + len + BlockSize - 1) / BlockSize;
+
+  // Check the cap before loading anything, so that a failed pin has no effect
+  size_t new_pins = 0;
+  for (uint64_t block_num = first_block;
+       block_num < end_block && pinned_blocks_ + new_pins <= MaxPinnedBlocks();
+       ++block_num) {
+    const Block* block = GetBlock((static_cast<uint64_t>(fd) << KFdOffset) | block_num);
+    if (block == nullptr || !block->pinned) {
+      ++new_pins;
+    }
+  }
+  if (pinned_blocks_ + new_pins > MaxPinnedBlocks()) {
+    return -1;  // Over the pinned memory cap
   }
 
-  return 0;  // Success
+  for (uint64_t block_num = first_block; block_num < end_block; ++block_num) {
+    const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | block_num;
+    Block* block = GetBlock(block_id);
+    if (block == nullptr) {
+      AlignedVec block_data;
+      if (FetchBlock(iter->second->os_fd, block_id, block_data) == -1) {
+        return -1;  // Read error, the blocks pinned so far stay pinned
+      }
+      block = LoadBlock(block_id, block_data);
+    }
+    if (!block->pinned) {
+      Dequeue(*block);
+      block->pinned = true;
+      ++pinned_blocks_;
+    }
+  }
+  return 0;
 }
 
-void FIFOCache::Touch(std::list<Block>::iterator /*it*/) {
-  // В FIFO порядок доступа не изменяется, поэтому данная функция не выполняет никаких действий.
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::UnpinRange(int fd, off_t offset, size_t len) {
+  const auto lock = LockCache();
+
+  if (!open_files_.contains(fd) || offset < 0) {
+    return -1;  // Invalid file descriptor or range
+  }
+
+  const uint64_t first_block = offset / BlockSize;
+  const uint64_t end_block = (offset + len + BlockSize - 1) / BlockSize;
+  ForEachBlockInRange(fd, first_block, end_block, [this](Block& block) {
+    if (block.pinned) {
+      block.pinned = false;
+      Enqueue(block);
+      --pinned_blocks_;
+    }
+  });
+  return 0;
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::SetRangePriority(int fd, off_t offset, size_t len, int priority) {
+  const auto lock = LockCache();
+
+  auto iter = open_files_.find(fd);
+  if (iter == open_files_.end()) {
+    return -1;  // Invalid file descriptor
+  }
+  if (offset < 0 || priority < LAB2_PRIORITY_LOW || priority > LAB2_PRIORITY_HIGH) {
+    return -1;  // Invalid range or priority
+  }
+
+  const uint64_t first_block = offset / BlockSize;
+  const uint64_t end_block = (offset + len + BlockSize - 1) / BlockSize;
+  if (first_block == end_block) {
+    return 0;
+  }
+
+  // Ranges covered by the new one no longer matter
+  auto& ranges = iter->second->priority_ranges;
+  std::erase_if(ranges, [first_block, end_block](const PriorityRange& range) {
+    return range.first_block >= first_block && range.end_block <= end_block;
+  });
+  ranges.push_back({first_block, end_block, static_cast<uint8_t>(priority)});
+
+  // Unpinned blocks join the tail of their new class's queue
+  ForEachBlockInRange(fd, first_block, end_block, [this, priority](Block& block) {
+    if (block.pinned) {
+      block.priority = static_cast<uint8_t>(priority);
+      return;
+    }
+    Dequeue(block);
+    block.priority = static_cast<uint8_t>(priority);
+    Enqueue(block);
+  });
+  return 0;
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::CreatePartition(
+    const std::string& name,
+    size_t min_percent,
+    size_t max_percent
+) {
+  const auto lock = LockCache();
+
+  if (name.empty() || min_percent > max_percent || max_percent == 0 || max_percent > 100) {
+    return -1;  // Invalid shares
+  }
+
+  size_t guaranteed = min_percent;
+  for (const auto& partition : partitions_) {
+    if (partition.name == name) {
+      return -1;  // Name taken
+    }
+    guaranteed += partition.min_percent;
+  }
+  if (guaranteed > 100) {
+    return -1;  // Guarantees exceed the capacity
+  }
+
+  partitions_.push_back({name, min_percent, max_percent});
+  return 0;
+}
+
+template <size_t BlockSize>
+CacheStats BasicFIFOCache<BlockSize>::GetStats() {
+  const auto lock = LockCache();
+
+  CacheStats stats = stats_;
+  stats.hits += thread_cache_hits_.load(std::memory_order_relaxed);
+  stats.frames = frames_in_use_;
+  stats.pinned_blocks = pinned_blocks_;
+  for (const auto& block : cache_list_) {
+    if (block.shared == ZeroFrame<BlockSize>()) {
+      ++stats.zero_blocks;
+    } else if (block.shared) {
+      ++stats.deduplicated_blocks;
+    }
+  }
+  if (compressed_tier_) {
+    const auto& tier_stats = compressed_tier_->GetStats();
+    stats.compressed_hits = tier_stats.hits;
+    stats.compressed_blocks = tier_stats.entries;
+    stats.compressed_bytes = tier_stats.used_bytes;
+    stats.compressed_rejected = tier_stats.rejected;
+    stats.compressed_capacity = compressed_frames_;
+  }
+  if (victim_cache_) {
+    const auto victim_stats = victim_cache_->GetStats();
+    stats.victim_hits = victim_stats.hits;
+    stats.victim_blocks = victim_stats.entries;
+  }
+  if (shared_tier_) {
+    const auto shared_stats = shared_tier_->GetStats();
+    stats.shared_hits = shared_hits_;
+    stats.shared_blocks = shared_stats.entries;
+    stats.shared_recoveries = shared_stats.recoveries;
+  }
+  if (journal_) {
+    const auto journal_stats = journal_->GetStats();
+    stats.journal_commits = journal_stats.commits;
+    stats.journal_syncs = journal_stats.syncs;
+  }
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    const Partition& partition = partitions_[i];
+    stats.partitions.push_back(
+        {partition.name,
+         partition.blocks,
+         MinBlocks(i),
+         MaxBlocks(i),
+         partition.hits,
+         partition.misses,
+         partition.evictions}
+    );
+  }
+  return stats;
+}
+
+// Private Methods
+
+template <size_t BlockSize>
+std::unique_lock<std::shared_mutex> BasicFIFOCache<BlockSize>::LockCache() {
+  LAB2_TRACE_SCOPE(LockWait, 0);
+  return std::unique_lock<std::shared_mutex>(cache_mutex_);
+}
+
+template <size_t BlockSize>
+Block* BasicFIFOCache<BlockSize>::GetBlock(uint64_t block_id) {
+  auto map_it = map_.find(block_id);
+  if (map_it == map_.end()) {
+    return nullptr;
+  }
+
+  // В FIFO порядок доступа не изменяется.
+  return &(*(map_it->second));
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::PutBlock(
+    uint64_t block_id,
+    const char* block_data,
+    size_t data_size
+) {
+  auto it = map_.find(block_id);
+  if (it != map_.end()) {
+    Block& block = *(it->second);
+    MakePrivate(block);
+    block.data.assign(block_data, block_data + data_size);
+    block.is_dirty = true;
+    InvalidateCopies(block_id);
+    // В FIFO порядок не обновляем, поэтому не вызываем Touch.
+  } else {
+    // Block not in cache, need to add it
+    const size_t partition = PartitionOf(block_id);
+    EvictIfNeeded(partition);
+
+    // Для FIFO вставляем новый блок в конец списка
+    cache_list_.emplace_back(block_id, AlignedVec(data_size));
+    ++frames_in_use_;
+    auto new_it = std::prev(cache_list_.end());
+    new_it->data.assign(block_data, block_data + data_size);
+    new_it->is_dirty = true;
+    ChargeBlock(*new_it, partition);
+    map_[block_id] = new_it;
+  }
+}
+
+template <size_t BlockSize>
+Block* BasicFIFOCache<BlockSize>::LoadBlock(uint64_t block_id, const AlignedVec& data) {
+  // Evict if cache is full
+  const size_t partition = PartitionOf(block_id);
+  EvictIfNeeded(partition);
+
+  // Для FIFO вставляем новый блок в конец списка. All-zero blocks share one
+  // frame, other full blocks may share a frame with identical contents.
+  if (data.size() == BlockSize && IsZeroFrame(data.data(), data.size())) {
+    cache_list_.emplace_back(block_id, ZeroFrame<BlockSize>(), 0);
+  } else if (options_.dedup_blocks && data.size() == BlockSize) {
+    const uint64_t hash = HashFrame(data.data(), data.size());
+    auto [frame_it, inserted] = shared_frames_.try_emplace(hash);
+    SharedFrame& shared = frame_it->second;
+    if (inserted) {
+      shared.frame = std::make_shared<const AlignedVec>(data);
+      ++frames_in_use_;
+    }
+    if (inserted || std::equal(data.begin(), data.end(), shared.frame->begin())) {
+      ++shared.users;
+      cache_list_.emplace_back(block_id, shared.frame, hash);
+    } else {
+      // Hash collision, keep the contents private
+      cache_list_.emplace_back(block_id, data, false);
+      ++frames_in_use_;
+    }
+  } else {
+    cache_list_.emplace_back(block_id, data, false);
+    ++frames_in_use_;
+  }
+  auto new_it = std::prev(cache_list_.end());
+  ChargeBlock(*new_it, partition);
+  map_[block_id] = new_it;
+  return &(*new_it);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::EvictIfNeeded(size_t partition) {
+  while (partitions_[partition].max_percent < 100 &&
+         partitions_[partition].blocks >= MaxBlocks(partition) && EvictFrom(partition)) {
+  }
+
+  while (!cache_list_.empty() &&
+         (frames_in_use_ >= ResidentCapacity() ||
+          cache_list_.size() >= ResidentCapacity() * KMaxBlocksPerFrame)) {
+    if (!EvictFrom(PickVictimPartition(partition)) && !EvictFrom(KAnyPartition)) {
+      break;  // Only pinned blocks are left
+    }
+  }
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::PickVictimPartition(size_t partition) const {
+  // Partitions borrowing the most beyond their guarantee give capacity back
+  // first; if none is above its guarantee, the growing partition makes room
+  size_t victim = partition;
+  size_t max_excess = 0;
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    const size_t min_blocks = MinBlocks(i);
+    if (partitions_[i].blocks > min_blocks && partitions_[i].blocks - min_blocks > max_excess) {
+      victim = i;
+      max_excess = partitions_[i].blocks - min_blocks;
+    }
+  }
+  return victim;
+}
+
+template <size_t BlockSize>
+bool BasicFIFOCache<BlockSize>::EvictFrom(size_t partition) {
+  const size_t first = partition == KAnyPartition ? 0 : partition;
+  const size_t last = partition == KAnyPartition ? partitions_.size() : partition + 1;
+  for (uint8_t priority = LAB2_PRIORITY_LOW; priority < KNumPriorities; ++priority) {
+    for (size_t i = first; i < last; ++i) {
+      // Для FIFO эвиктируем самый старый блок класса (в начале его очереди)
+      const auto& queue = partitions_[i].queues[priority];
+      if (!queue.empty()) {
+        EvictBlock(map_.at(queue.front()->block_id));
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::ChargeBlock(Block& block, size_t partition) {
+  block.partition = partition;
+  block.priority = PriorityOf(block.block_id);
+  ++partitions_[partition].blocks;
+  Enqueue(block);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::Enqueue(Block& block) {
+  auto& queue = partitions_[block.partition].queues[block.priority];
+  block.queue_it = queue.insert(queue.end(), &block);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::Dequeue(Block& block) {
+  partitions_[block.partition].queues[block.priority].erase(block.queue_it);
+}
+
+template <size_t BlockSize>
+uint8_t BasicFIFOCache<BlockSize>::PriorityOf(uint64_t block_id) const {
+  auto it = open_files_.find(static_cast<int>(block_id >> KFdOffset));
+  if (it == open_files_.end()) {
+    return LAB2_PRIORITY_NORMAL;
+  }
+
+  const uint64_t block_num = block_id & 0xFFFFFFFF;
+  const auto& ranges = it->second->priority_ranges;
+  for (auto range_it = ranges.rbegin(); range_it != ranges.rend(); ++range_it) {
+    if (block_num >= range_it->first_block && block_num < range_it->end_block) {
+      return range_it->priority;
+    }
+  }
+  return LAB2_PRIORITY_NORMAL;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::ForEachBlockInRange(
+    int fd,
+    uint64_t first_block,
+    uint64_t end_block,
+    const std::function<void(Block&)>& visit
+) {
+  // Look the blocks up one by one unless the range is larger than the cache
+  if (end_block - first_block <= cache_list_.size()) {
+    for (uint64_t block_num = first_block; block_num < end_block; ++block_num) {
+      if (Block* block = GetBlock((static_cast<uint64_t>(fd) << KFdOffset) | block_num)) {
+        visit(*block);
+      }
+    }
+    return;
+  }
+
+  for (auto& block : cache_list_) {
+    const uint64_t block_num = block.block_id & 0xFFFFFFFF;
+    if ((block.block_id >> KFdOffset) == static_cast<uint64_t>(fd) && block_num >= first_block &&
+        block_num < end_block) {
+      visit(block);
+    }
+  }
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::MaxPinnedBlocks() const {
+  return capacity_ * std::min(options_.max_pinned_percent, KMaxPinnedPercent) / 100;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::EvictBlock(std::list<Block>::iterator it) {
+  LAB2_TRACE_SCOPE(Evict, it->block_id);
+  Block& block_to_evict = *it;
+  if (block_to_evict.is_dirty || block_to_evict.is_journaled) {
+    ++stats_.dirty_evictions;
+    if (WriteBlockToDisk(block_to_evict) == 0) {
+      block_to_evict.is_dirty = false;
+    }
+  }
+
+  // Clean blocks move down to the lower tiers rather than being dropped
+  if (!block_to_evict.is_dirty) {
+    DemoteBlock(block_to_evict);
+  }
+
+  ++partitions_[block_to_evict.partition].evictions;
+  InvalidateThreadCaches(block_to_evict.block_id);
+  ReleaseFrame(block_to_evict);
+  map_.erase(block_to_evict.block_id);
+  cache_list_.erase(it);
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::PartitionOf(uint64_t block_id) const {
+  auto it = open_files_.find(static_cast<int>(block_id >> KFdOffset));
+  return it != open_files_.end() ? it->second->partition : 0;
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::MinBlocks(size_t partition) const {
+  return ResidentCapacity() * partitions_[partition].min_percent / 100;
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::MaxBlocks(size_t partition) const {
+  return std::max<size_t>(1, ResidentCapacity() * partitions_[partition].max_percent / 100);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::CountAccess(uint64_t block_id, bool hit) {
+  Partition& partition = partitions_[PartitionOf(block_id)];
+  if (hit) {
+    LAB2_TRACE_INSTANT(LookupHit, block_id);
+    ++stats_.hits;
+    ++partition.hits;
+  } else {
+    LAB2_TRACE_INSTANT(LookupMiss, block_id);
+    ++stats_.misses;
+    ++partition.misses;
+  }
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::MakePrivate(Block& block) {
+  if (!block.shared) {
+    return;
+  }
+  block.data.assign(block.shared->begin(), block.shared->end());
+  ReleaseSharedFrame(block);
+  ++frames_in_use_;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::ShareIfZero(Block& block) {
+  if (block.shared || block.data.size() != BlockSize ||
+      !IsZeroFrame(block.data.data(), block.data.size())) {
+    return;
+  }
+  AlignedVec().swap(block.data);
+  block.shared = ZeroFrame<BlockSize>();
+  --frames_in_use_;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::ReleaseFrame(Block& block) {
+  Partition& partition = partitions_[block.partition];
+  --partition.blocks;
+  if (block.pinned) {
+    --pinned_blocks_;
+  } else {
+    Dequeue(block);
+  }
+  if (block.shared) {
+    ReleaseSharedFrame(block);
+  } else {
+    --frames_in_use_;
+  }
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::ReleaseSharedFrame(Block& block) {
+  if (block.shared != ZeroFrame<BlockSize>()) {
+    auto it = shared_frames_.find(block.shared_hash);
+    if (--it->second.users == 0) {
+      shared_frames_.erase(it);
+      --frames_in_use_;
+    }
+  }
+  block.shared.reset();
+  block.shared_hash = 0;
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::ResidentCapacity() const {
+  return capacity_ - compressed_frames_;
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::MaxCompressedFrames() const {
+  // Pinned blocks can't be evicted, so they and one unpinned block must always
+  // fit in what the compressed tier leaves
+  return std::min(
+      capacity_ - MaxPinnedBlocks() - 1, capacity_ * options_.compressed_tier_max_percent / 100
+  );
+}
+
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::FetchBlock(int os_fd, uint64_t block_id, AlignedVec& data) {
+  CountAccess(block_id, false);
+  LAB2_TRACE_SCOPE(Fetch, block_id);
+  if (FetchFromLowerTiers(block_id, data)) {
+    data.resize(BlockSize, 0);
+    return static_cast<ssize_t>(BlockSize);
+  }
+
+  // Bytes past the end of the file stay zero
+  const uint64_t block_num = block_id & 0xFFFFFFFF;
+  const SharedFileKey shared_key = SharedKeyOf(block_id);
+  const uint64_t token = shared_tier_ ? shared_tier_->FillToken(shared_key, block_num) : 0;
+  data.assign(BlockSize, 0);
+  const ssize_t bytes_read =
+      pread(os_fd, data.data(), BlockSize, static_cast<off_t>(block_num) * BlockSize);
+  if (shared_tier_ && bytes_read != -1) {
+    shared_tier_->Fill(shared_key, block_num, data.data(), token);
+  }
+  return bytes_read;
+}
+
+template <size_t BlockSize>
+bool BasicFIFOCache<BlockSize>::FetchFromLowerTiers(uint64_t block_id, AlignedVec& data) {
+  if (TakeFromCompressedTier(block_id, data)) {
+    return true;
+  }
+  if (shared_tier_ && shared_tier_->Get(SharedKeyOf(block_id), block_id & 0xFFFFFFFF, data)) {
+    ++shared_hits_;
+    return true;
+  }
+  return victim_cache_ && victim_cache_->Get(block_id, data);
+}
+
+template <size_t BlockSize>
+bool BasicFIFOCache<BlockSize>::ReadShared(
+    uint64_t block_id,
+    size_t block_offset,
+    char* buf,
+    size_t size
+) {
+  if (!shared_tier_ ||
+      !shared_tier_->Read(SharedKeyOf(block_id), block_id & 0xFFFFFFFF, block_offset, buf, size)) {
+    return false;
+  }
+  CountAccess(block_id, false);
+  ++shared_hits_;
+  return true;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::UpdateSharedFile(FileHandle& file) {
+  struct stat stat_data = {};
+  if (shared_tier_ && fstat(file.os_fd, &stat_data) == 0) {
+    shared_tier_->UpdateFile(file.shared_key, ChangeTimeNs(stat_data));
+  }
+}
+
+template <size_t BlockSize>
+SharedFileKey BasicFIFOCache<BlockSize>::SharedKeyOf(uint64_t block_id) const {
+  auto it = open_files_.find(static_cast<int>(block_id >> KFdOffset));
+  return it != open_files_.end() ? it->second->shared_key : SharedFileKey{};
+}
+
+template <size_t BlockSize>
+bool BasicFIFOCache<BlockSize>::TakeFromCompressedTier(uint64_t block_id, AlignedVec& data) {
+  if (!compressed_tier_) {
+    return false;
+  }
+
+  const bool found = compressed_tier_->Take(block_id, data);
+  if (found) {
+    ++window_compressed_hits_;
+  }
+  AdaptCompressedTier();
+  return found;
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::DemoteBlock(const Block& block) {
+  if (block.Size() == 0) {
+    return;
+  }
+  if (compressed_tier_ && compressed_tier_->Put(block.block_id, block.Data(), block.Size())) {
+    return;
+  }
+  if (victim_cache_) {
+    victim_cache_->Put(block.block_id, block.Data(), block.Size());
+  }
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::AdaptCompressedTier() {
+  if (++window_misses_ < KAdaptWindow) {
+    return;
+  }
+
+  const size_t step = std::max<size_t>(1, capacity_ / 16);
+  const size_t max_frames = MaxCompressedFrames();
+  const size_t min_frames = std::min(step, max_frames);
+  const size_t hit_percent = window_compressed_hits_ * 100 / window_misses_;
+  const auto& tier_stats = compressed_tier_->GetStats();
+  const bool tier_full =
+      tier_stats.used_bytes + compressed_tier_->MaxCompressedSize() > compressed_tier_->Budget();
+
+  if (hit_percent >= KGrowHitPercent && tier_full) {
+    compressed_frames_ = std::min(max_frames, compressed_frames_ + step);
+  } else if (hit_percent < KShrinkHitPercent) {
+    const size_t shrink = std::min(step, compressed_frames_);
+    compressed_frames_ = std::max(min_frames, compressed_frames_ - shrink);
+  }
+  compressed_tier_->SetBudget(compressed_frames_ * BlockSize);
+
+  window_misses_ = 0;
+  window_compressed_hits_ = 0;
+}
+
+template <size_t BlockSize>
+std::atomic<uint64_t>& BasicFIFOCache<BlockSize>::BlockVersion(uint64_t block_id) {
+  return block_versions_[((block_id >> KFdOffset) * 0x9E3779B1U + block_id) % KVersionStripes];
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::InvalidateThreadCaches(uint64_t block_id) {
+  BlockVersion(block_id).fetch_add(1, std::memory_order_release);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::InvalidateCopies(uint64_t block_id) {
+  InvalidateThreadCaches(block_id);
+  if (compressed_tier_) {
+    compressed_tier_->Erase(block_id);
+  }
+  if (victim_cache_) {
+    victim_cache_->Invalidate(block_id);
+  }
+  if (shared_tier_) {
+    shared_tier_->Erase(SharedKeyOf(block_id), block_id & 0xFFFFFFFF);
+  }
+}
+
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::ReadFromThreadCache(int fd, char* buf, size_t size) {
+  ThreadCache& thread_cache = ThreadCache::Local();
+
+  FileHandle* file = thread_cache.FindFile(id_, fd);
+  if (file == nullptr || file->closed.load(std::memory_order_acquire)) {
+    return -1;
+  }
+
+  off_t current_pos = file->position.load(std::memory_order_acquire);
+  const size_t size_to_read = BytesBeforeEof(*file, current_pos, size);
+  size_t bytes_read_total = 0;
+  size_t hits = 0;
+
+  while (bytes_read_total < size_to_read) {
+    const uint64_t block_num = current_pos / BlockSize;
+    const size_t block_offset = current_pos % BlockSize;
+    const size_t bytes_to_read =
+        std::min(BlockSize - block_offset, size_to_read - bytes_read_total);
+    const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | block_num;
+
+    const ThreadCache::Entry* entry = thread_cache.Find(id_, block_id);
+    if (entry == nullptr ||
+        BlockVersion(block_id).load(std::memory_order_acquire) != entry->version) {
+      return -1;  // Missing or stale, take the slow path
+    }
+
+    const size_t available = entry->size > block_offset ? entry->size - block_offset : 0;
+    const size_t copy_size = std::min(bytes_to_read, available);
+    std::memcpy(buf + bytes_read_total, entry->data.data() + block_offset, copy_size);
+    bytes_read_total += copy_size;
+    current_pos += static_cast<off_t>(copy_size);
+    ++hits;
+
+    if (copy_size < bytes_to_read) {
+      break;  // Reached EOF
+    }
+  }
+
+  // Another thread moved the position meanwhile, the data may be for the wrong range
+  off_t expected_pos = current_pos - static_cast<off_t>(bytes_read_total);
+  if (!file->position.compare_exchange_strong(expected_pos, current_pos)) {
+    return -1;
+  }
+  thread_cache_hits_.fetch_add(hits, std::memory_order_relaxed);
+  return static_cast<ssize_t>(bytes_read_total);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::RememberInThreadCache(
+    int fd,
+    const std::shared_ptr<FileHandle>& file,
+    const Block& block
+) {
+  ThreadCache& thread_cache = ThreadCache::Local();
+  thread_cache.PutFile(id_, fd, file);
+  thread_cache.Put(
+      id_,
+      block.block_id,
+      BlockVersion(block.block_id).load(std::memory_order_relaxed),
+      block.Data(),
+      block.Size()
+  );
+}
+
+template <size_t BlockSize>
+size_t BasicFIFOCache<BlockSize>::BypassBytes(FileHandle& file, off_t position, size_t size) {
+  if (position != file.scan_end) {
+    file.scan_bytes = 0;
+  }
+  const size_t threshold = file.scan_bytes >= KScanBytes ? KScanBypassBytes : KBypassBytes;
+  file.scan_bytes += size;
+  file.scan_end = position + static_cast<off_t>(size);
+
+  if (position % BlockSize != 0 || size < threshold) {
+    return 0;
+  }
+  return size - size % BlockSize;
+}
+
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::ReadDirect(
+    std::unique_lock<std::shared_mutex>& lock,
+    int fd,
+    std::shared_ptr<FileHandle> file,
+    char* buf,
+    off_t offset,
+    size_t size
+) {
+  // Dirty blocks and blocks committed only to the journal are newer in the
+  // cache. Copied now, as they may be written back while the disk is read.
+  const uint64_t first_block = offset / BlockSize;
+  std::vector<std::pair<size_t, AlignedVec>> newer;
+  for (size_t i = 0; i < size / BlockSize; ++i) {
+    const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | (first_block + i);
+    auto it = map_.find(block_id);
+    if (it != map_.end() && (it->second->is_dirty || it->second->is_journaled)) {
+      const Block& block = *it->second;
+      newer.emplace_back(i, AlignedVec(block.Data(), block.Data() + block.Size()));
+    }
+  }
+
+  lock.unlock();
+  const bool aligned = reinterpret_cast<uintptr_t>(buf) % KFrameAlignment == 0;
+  AlignedVec bounce(aligned ? 0 : std::min(size, KBounceBufferBytes));
+
+  size_t done = 0;
+  while (done < size) {
+    const size_t chunk = aligned ? size - done : std::min(size - done, bounce.size());
+    char* target = aligned ? buf + done : bounce.data();
+    const ssize_t bytes_read = pread(file->os_fd, target, chunk, offset + static_cast<off_t>(done));
+    if (bytes_read == -1) {
+      lock.lock();
+      return -1;  // Read error
+    }
+
+    // Past the end of the file on disk the blocks read as zeros, as in
+    // FetchBlock. A short read ends the data on disk.
+    std::memset(target + bytes_read, 0, chunk - bytes_read);
+    if (!aligned) {
+      std::memcpy(buf + done, target, chunk);
+    }
+    done += chunk;
+    if (static_cast<size_t>(bytes_read) < chunk) {
+      std::memset(buf + done, 0, size - done);
+      break;
+    }
+  }
+
+  lock.lock();
+  if (file->closed) {
+    return -1;  // Closed meanwhile
+  }
+
+  // Blocks written meanwhile are newer still
+  for (const auto& [i, data] : newer) {
+    std::memcpy(buf + i * BlockSize, data.data(), data.size());
+  }
+  for (size_t i = 0; i < size / BlockSize; ++i) {
+    const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | (first_block + i);
+    auto it = map_.find(block_id);
+    if (it != map_.end() && (it->second->is_dirty || it->second->is_journaled)) {
+      std::memcpy(buf + i * BlockSize, it->second->Data(), it->second->Size());
+    }
+  }
+
+  ++stats_.bypass_reads;
+  stats_.bypass_bytes += size;
+  return static_cast<ssize_t>(size);
+}
+
+template <size_t BlockSize>
+ssize_t BasicFIFOCache<BlockSize>::WriteAt(
+    int fd,
+    FileHandle& file,
+    const char* buf,
+    size_t size,
+    off_t offset
+) {
+  off_t current_pos = offset;
+  size_t bytes_written_total = 0;
+  WriteModeStats& mode_stats = stats_.write_modes[file.write_mode];
+
+  while (bytes_written_total < size) {
+    const int block_num = current_pos / BlockSize;
+    const size_t block_offset = current_pos % BlockSize;
+    const size_t bytes_to_write = std::min(BlockSize - block_offset, size - bytes_written_total);
+
+    // Create a unique block identifier, e.g., (fd << 32) | block_num
+    const uint64_t block_id = (static_cast<uint64_t>(fd) << KFdOffset) | block_num;
+    ++mode_stats.blocks;
+
+    Block* block = GetBlock(block_id);
+    if (block != nullptr) {
+      CountAccess(block_id, true);
+    } else if (file.write_mode == LAB2_WRITE_AROUND) {
+      if (WriteAroundCache(
+              file.os_fd, block_id, buf + bytes_written_total, block_offset, bytes_to_write
+          ) == -1) {
+        return -1;  // Read or write error
+      }
+      ++mode_stats.disk_writes;
+      bytes_written_total += bytes_to_write;
+      current_pos += bytes_to_write;
+      continue;
+    } else {
+      AlignedVec block_data;
+      if (FetchBlock(file.os_fd, block_id, block_data) == -1) {
+        return -1;  // Read error
+      }
+      PutBlock(block_id, block_data.data(), BlockSize);
+      block = GetBlock(block_id);
+      if (block == nullptr) {
+        return -1;  // Failed to load block
+      }
+      ++mode_stats.admitted_blocks;
+    }
+
+    // Write data from buffer to block
+    MakePrivate(*block);
+    std::memcpy(block->data.data() + block_offset, buf + bytes_written_total, bytes_to_write);
+    block->is_dirty = true;
+    InvalidateCopies(block_id);
+
+    // Blocks already cached are written through in write-around mode too
+    if (file.write_mode != LAB2_WRITE_BACK) {
+      if (WriteBlockToDisk(*block) == -1) {
+        return -1;  // Write error
+      }
+      block->is_dirty = false;
+      ++mode_stats.disk_writes;
+    }
+    ShareIfZero(*block);
+    bytes_written_total += bytes_to_write;
+    current_pos += bytes_to_write;
+  }
+
+  if (current_pos > file.size) {
+    file.size = current_pos;
+  }
+  return bytes_written_total;
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::WriteBlockToDisk(Block& block) {
+  LAB2_TRACE_SCOPE(Writeback, block.block_id);
+  const int fd = block.block_id >> KFdOffset;
+  const int block_num = block.block_id & 0xFFFFFFFF;
+
+  auto iter = open_files_.find(fd);
+  if (iter == open_files_.end()) {
+    return -1;  // Invalid file descriptor
+  }
+
+  // Log newer contents than the journal has, so that a later commit of the
+  // file replays them over older committed copies. Files without a commit in
+  // the journal have none to protect against.
+  FileHandle& file = *iter->second;
+  SupersedeCheckpointWrite(block.block_id);
+  if (journal_ && block.is_dirty && committed_paths_.contains(file.path)) {
+    const std::vector<Journal::BlockRecord> records = {{block.block_id & 0xFFFFFFFF, block.Data()}};
+    if (journal_->Append(file.path, records) == -1) {
+      return -1;  // Journal write error
+    }
+    RequestCheckpointIfFull();
+  }
+
+  // Blocks are always written whole, even past the logical end of the file
+  const off_t offset = static_cast<off_t>(block_num) * BlockSize;
+  const ssize_t bytes_written = pwrite(file.os_fd, block.Data(), block.Size(), offset);
+  if (bytes_written == -1) {
+    return -1;  // Write error
+  }
+  file.disk_size = std::max(file.disk_size, offset + static_cast<off_t>(bytes_written));
+  file.home_unsynced = journal_ != nullptr;
+  block.is_journaled = false;
+  UpdateSharedFile(file);
+
+  // Other processes may now read the new contents from the shared tier
+  if (shared_tier_ && bytes_written == static_cast<ssize_t>(BlockSize)) {
+    shared_tier_->Publish(file.shared_key, block_num, block.Data());
+  }
+
+  return 0;  // Success
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::WriteAroundCache(
+    int os_fd,
+    uint64_t block_id,
+    const char* buf,
+    size_t block_offset,
+    size_t size
+) {
+  // Written whole like any other block, so that it goes through the journal
+  // and updates the disk size the same way. The rest of the block is read
+  // straight from disk, which has its latest contents as it is not cached,
+  // without counting a miss or moving lower tier copies about to be dropped.
+  // Bytes past the end of the file stay zero.
+  Block block(block_id, AlignedVec(BlockSize, 0), true);
+  const off_t offset = static_cast<off_t>(block_id & 0xFFFFFFFF) * BlockSize;
+  if (size < BlockSize && pread(os_fd, block.data.data(), BlockSize, offset) == -1) {
+    return -1;  // Read error
+  }
+  std::memcpy(block.data.data() + block_offset, buf, size);
+  InvalidateCopies(block_id);
+  return WriteBlockToDisk(block);
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::SyncFileSize(FileHandle& file) {
+  const off_t size = file.size;
+  if (file.disk_size == size) {
+    return 0;
+  }
+  if (ftruncate(file.os_fd, size) == -1) {
+    return -1;
+  }
+  file.disk_size = size;
+  file.home_unsynced = journal_ != nullptr;
+  UpdateSharedFile(file);
+  return 0;
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::CommitToJournal(
+    std::unique_lock<std::shared_mutex>& lock,
+    int fd,
+    FileHandle& file
+) {
+  std::vector<Block*> dirty_blocks;
+  std::vector<Journal::BlockRecord> records;
+  for (auto& block : cache_list_) {
+    if ((block.block_id >> KFdOffset) == static_cast<uint64_t>(fd) && block.is_dirty) {
+      dirty_blocks.push_back(&block);
+      records.push_back({block.block_id & 0xFFFFFFFF, block.Data()});
+    }
+  }
+
+  const int64_t sequence = journal_->Commit(file.path, records, file.size);
+  if (sequence == -1) {
+    return -1;  // Journal write error
+  }
+  for (Block* block : dirty_blocks) {
+    block->is_dirty = false;
+    block->is_journaled = true;
+    block->journal_sequence = sequence;
+  }
+  committed_paths_.insert(file.path);
+  RequestCheckpointIfFull();
+
+  // Concurrent syncs can append their commits while this one waits, and
+  // share its fdatasync
+  lock.unlock();
+  return journal_->WaitDurable(sequence);
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::RequestCheckpointIfFull() {
+  if (journal_->Size() >= options_.journal_checkpoint_bytes) {
+    {
+      const std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+      checkpoint_requested_ = true;
+    }
+    checkpoint_wanted_.notify_one();
+  }
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::Checkpoint() {
+  for (auto& block : cache_list_) {
+    if (block.is_journaled) {
+      if (WriteBlockToDisk(block) == -1) {
+        return -1;  // Write error
+      }
+      block.is_dirty = false;
+    }
+  }
+
+  for (auto& [user_fd, file] : open_files_) {
+    if (SyncFileSize(*file) == -1) {
+      return -1;  // ftruncate failed
+    }
+    if (file->home_unsynced) {
+      if (fsync(file->os_fd) == -1) {
+        return -1;  // fsync failed
+      }
+      file->home_unsynced = false;
+    }
+  }
+
+  if (journal_->Reset() == -1) {
+    return -1;
+  }
+  committed_paths_.clear();
+  ++stats_.checkpoints;
+  return 0;
+}
+
+template <size_t BlockSize>
+int BasicFIFOCache<BlockSize>::CheckpointInBackground() {
+  std::unordered_map<int, int> os_fds;  // Duplicated descriptors of the files to sync
+  {
+    const auto lock = LockCache();
+    for (auto& [user_fd, file] : open_files_) {
+      SyncFileSize(*file);
+    }
+    for (const auto& block : cache_list_) {
+      if (!block.is_journaled) {
+        continue;
+      }
+      const int fd = static_cast<int>(block.block_id >> KFdOffset);
+      auto [fd_it, inserted] = os_fds.try_emplace(fd, -1);
+      if (inserted) {
+        fd_it->second = dup(open_files_[fd]->os_fd);
+      }
+      checkpoint_index_[block.block_id] = checkpoint_writes_.size();
+      checkpoint_writes_.push_back(
+          {block.block_id,
+           block.journal_sequence,
+           fd_it->second,
+           AlignedVec(block.Data(), block.Data() + block.Size())}
+      );
+    }
+    // Files written home again from now on are marked unsynced again
+    for (auto& [user_fd, file] : open_files_) {
+      if (file->home_unsynced && !os_fds.contains(user_fd)) {
+        os_fds[user_fd] = dup(file->os_fd);
+      }
+      if (os_fds.contains(user_fd)) {
+        file->home_unsynced = false;
+      }
+    }
+  }
+
+  // Descriptors that failed to duplicate fail their writes and syncs
+  bool failed = false;
+  for (auto& write : checkpoint_writes_) {
+    const std::lock_guard<std::mutex> io_lock(checkpoint_io_mutex_);
+    if (write.superseded) {
+      continue;
+    }
+    const off_t offset = static_cast<off_t>(write.block_id & 0xFFFFFFFF) * BlockSize;
+    write.written = pwrite(write.os_fd, write.data.data(), write.data.size(), offset) ==
+                    static_cast<ssize_t>(write.data.size());
+    failed = failed || !write.written;
+  }
+  for (const auto& [user_fd, os_fd] : os_fds) {
+    if (fsync(os_fd) == -1) {
+      failed = true;
+    }
+  }
+
+  const auto lock = LockCache();
+  for (const auto& write : checkpoint_writes_) {
+    const int fd = static_cast<int>(write.block_id >> KFdOffset);
+    auto file_it = open_files_.find(fd);
+    if (failed || !write.written || write.superseded || file_it == open_files_.end()) {
+      continue;
+    }
+    FileHandle& file = *file_it->second;
+    const off_t end = static_cast<off_t>((write.block_id & 0xFFFFFFFF) + 1) * BlockSize;
+    file.disk_size = std::max(file.disk_size, end);
+
+    // Blocks committed again meanwhile stay journaled
+    auto block_it = map_.find(write.block_id);
+    if (block_it != map_.end() && block_it->second->is_journaled &&
+        block_it->second->journal_sequence == write.journal_sequence) {
+      block_it->second->is_journaled = false;
+    }
+  }
+  checkpoint_writes_.clear();
+  checkpoint_index_.clear();
+  for (const auto& [user_fd, os_fd] : os_fds) {
+    if (os_fd != -1) {
+      close(os_fd);
+    }
+    auto file_it = open_files_.find(user_fd);
+    if (failed && file_it != open_files_.end()) {
+      file_it->second->home_unsynced = true;
+    } else if (file_it != open_files_.end()) {
+      UpdateSharedFile(*file_it->second);
+    }
+  }
+  if (failed) {
+    return -1;  // Write or fsync error, the journal is kept
+  }
+
+  // Only the blocks and files written again meanwhile are left to the lock
+  return Checkpoint();
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::SupersedeCheckpointWrite(uint64_t block_id) {
+  if (checkpoint_index_.empty()) {
+    return;
+  }
+  auto it = checkpoint_index_.find(block_id);
+  if (it != checkpoint_index_.end()) {
+    const std::lock_guard<std::mutex> io_lock(checkpoint_io_mutex_);
+    checkpoint_writes_[it->second].superseded = true;
+  }
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::CheckpointLoop() {
+  std::unique_lock<std::mutex> lock(checkpoint_mutex_);
+  while (true) {
+    checkpoint_wanted_.wait(lock, [this] {
+      return stop_checkpointer_ || checkpoint_requested_;
+    });
+    if (stop_checkpointer_) {
+      return;
+    }
+    checkpoint_requested_ = false;
+    lock.unlock();
+    CheckpointInBackground();
+    lock.lock();
+  }
+}
+
+template <size_t BlockSize>
+void BasicFIFOCache<BlockSize>::Touch(std::list<Block>::iterator /*it*/) {
+  // В FIFO порядок доступа не изменяется, поэтому данная функция не выполняет никаких действий.
+}
+
+template class BasicFIFOCache<4096>;
+template class BasicFIFOCache<16 * 1024>;
+template class BasicFIFOCache<64 * 1024>;
+
+std::unique_ptr<PageCache> CreateCache(
+    size_t block_size,
+    size_t capacity,
+    const CacheOptions& options
+) {
+  switch (block_size) {
+    case 4096:
+      return std::make_unique<BasicFIFOCache<4096>>(capacity, options);
+    case 16 * 1024:
+      return std::make_unique<BasicFIFOCache<16 * 1024>>(capacity, options);
+    case 64 * 1024:
+      return std::make_unique<BasicFIFOCache<64 * 1024>>(capacity, options);
+    default:
+      return nullptr;  // Not instantiated
+  }
 }
 
 }  // namespace lab2
@@ -1,50 +1,399 @@
 #pragma once
 
+#include <sys/stat.h>
 #include <sys/types.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "./Api.hpp"
 #include "./Block.hpp"
+#include "./CompressedTier.hpp"
+#include "./IoPool.hpp"
+#include "./Journal.hpp"
+#include "./SharedTier.hpp"
+#include "./VictimCache.hpp"
 
 namespace lab2 {
 
-class FIFOCache {
+// Optional features of the cache, all disabled by default.
+struct CacheOptions {
+  // Serve repeated hits from a small per-thread front cache, without taking
+  // the cache lock.
+  bool thread_cache = false;
+
+  // Keep clean blocks leaving the cache compressed in memory instead of
+  // dropping them. The compressed tier borrows up to
+  // compressed_tier_max_percent of the capacity, adapting its share to its
+  // observed hit rate. It never takes the room that pinned blocks may need.
+  bool compressed_tier = false;
+  size_t compressed_tier_max_percent = 50;
+
+  // Keep clean blocks leaving the memory tiers in a second-level cache file
+  // of victim_cache_blocks blocks, ideally on a fast local disk. Disabled
+  // when the path is empty.
+  std::string victim_cache_path;
+  size_t victim_cache_blocks = 0;
+
+  // Share clean blocks with other processes through a shared memory tier,
+  // the POSIX shared memory object shared_tier_name. The first process to
+  // attach creates it with room for shared_tier_blocks blocks. Misses of the
+  // private cache look the tier up before the victim cache and disk, and
+  // reads it serves are not admitted privately. Blocks read from disk or
+  // written back are stored in it, and rewrites drop the shared copies.
+  // Disabled when the name is empty.
+  std::string shared_tier_name;
+  size_t shared_tier_blocks = 0;
+
+  // Serve large block-aligned reads straight from disk into the caller's
+  // buffer, without admitting their blocks. The size from which reads bypass
+  // the cache drops once a file is being scanned sequentially.
+  bool read_bypass = false;
+
+  // Share one frame between clean blocks with identical contents, across
+  // files. All-zero blocks always share the zero frame.
+  bool dedup_blocks = false;
+
+  // Commit syncs to a write-ahead journal at journal_path, shared by all
+  // files, instead of writing the blocks home. Blocks are checkpointed home in
+  // the background once the journal grows past journal_checkpoint_bytes.
+  // Committed syncs found in the journal are replayed when the cache is
+  // created. Disabled when the path is empty.
+  std::string journal_path;
+  size_t journal_checkpoint_bytes = 64 * 1024 * 1024;
+
+  // Share of the capacity that blocks pinned with PinRange may take, in
+  // percent, up to 90 so that unpinned blocks can always be loaded.
+  size_t max_pinned_percent = 25;
+
+  // Reads the options from LAB2_* environment variables, used by the C API.
+  static CacheOptions FromEnv();
+};
+
+// Counters of one cache partition.
+struct PartitionStats {
+  std::string name;
+  size_t blocks = 0;
+  size_t min_blocks = 0;
+  size_t max_blocks = 0;
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+};
+
+// Number of lab2_write_mode values.
+static constexpr size_t KNumWriteModes = LAB2_WRITE_AROUND + 1;
+
+// Counters of the writes made in one write mode, showing how much of the
+// cache they take.
+struct WriteModeStats {
+  size_t blocks = 0;           // Block writes, partial ones included
+  size_t admitted_blocks = 0;  // Blocks loaded into the cache by the writes
+  size_t disk_writes = 0;      // Blocks written to disk as part of the writes
+};
+
+// Counters describing the cache behaviour since its creation.
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t compressed_hits = 0;
+  size_t compressed_blocks = 0;
+  size_t compressed_bytes = 0;
+  size_t compressed_rejected = 0;  // Incompressible blocks dropped
+  size_t compressed_capacity = 0;  // Blocks of the capacity lent to the compressed tier
+  size_t victim_hits = 0;
+  size_t victim_blocks = 0;
+  size_t shared_hits = 0;        // Hits of this cache in the shared tier
+  size_t shared_blocks = 0;      // Blocks in the shared tier, from every process
+  size_t shared_recoveries = 0;  // Shared tier shards repaired after a process died
+  size_t frames = 0;               // Frames charged against the capacity
+  size_t zero_blocks = 0;          // Blocks using the shared zero frame
+  size_t deduplicated_blocks = 0;  // Blocks using a deduplicated frame
+  size_t journal_commits = 0;
+  size_t journal_syncs = 0;  // Shared by the commits grouped together
+  size_t checkpoints = 0;
+  size_t pinned_blocks = 0;
+  size_t bypass_reads = 0;  // Reads served straight from disk
+  size_t bypass_bytes = 0;
+  size_t dirty_evictions = 0;  // Evictions that had to write the block back
+  std::array<WriteModeStats, KNumWriteModes> write_modes;  // Indexed by lab2_write_mode
+  std::vector<PartitionStats> partitions;  // The default partition first
+};
+
+// Eviction priority of the blocks [first_block, end_block) of a file.
+struct PriorityRange {
+  uint64_t first_block;
+  uint64_t end_block;
+  uint8_t priority;
+};
+
+// State of a file opened through the cache.
+struct FileHandle {
+  int os_fd;
+  // Current file position. Atomic so that the thread cache can advance it
+  // without taking the cache lock.
+  std::atomic<off_t> position{0};
+  // Set on close, invalidating thread cache references to the handle.
+  std::atomic<bool> closed{false};
+  // Logical size of the file, including writes not yet on disk. Atomic so
+  // that the thread cache can detect EOF without taking the cache lock.
+  std::atomic<off_t> size{0};
+  // Size of the file on disk. Blocks are written back whole, so it may run
+  // past the logical size until the file is truncated on sync or close.
+  off_t disk_size = 0;
+  // Absolute path naming the file in journal records.
+  std::string path;
+  // Set in journal mode when the file was written since its last fsync.
+  bool home_unsynced = false;
+  // Cache partition charged for the file's blocks.
+  size_t partition = 0;
+  // lab2_write_mode of the file's writes.
+  int write_mode = LAB2_WRITE_BACK;
+  // Identity of the file in the shared tier.
+  SharedFileKey shared_key;
+  // End of the last read and the bytes read sequentially up to it, for the
+  // scan detection of the read bypass.
+  off_t scan_end = 0;
+  size_t scan_bytes = 0;
+  // Priorities set with SetRangePriority, later ranges take precedence.
+  std::vector<PriorityRange> priority_ranges;
+
+  FileHandle(int fd, off_t file_size)
+      : os_fd(fd)
+      , size(file_size)
+      , disk_size(file_size) {
+  }
+};
+
+// Interface of the cache, whatever its block size. Implemented by
+// BasicFIFOCache, created with a runtime block size by CreateCache.
+class PageCache {
+public:
+  virtual ~PageCache() = default;
+
+  // Size of the cache blocks in bytes.
+  virtual size_t GetBlockSize() const = 0;
+
+  // API functions
+  virtual int OpenFile(const std::string& path, const lab2_open_options* options = nullptr) = 0;
+  virtual int CloseFile(int fd) = 0;
+  virtual ssize_t ReadFile(int fd, char* buf, size_t size) = 0;
+  virtual ssize_t WriteFile(int fd, const char* buf, size_t size) = 0;
+  // Writes at offset without moving the file position, like pwrite.
+  virtual ssize_t PWriteFile(int fd, const char* buf, size_t size, off_t offset) = 0;
+  virtual off_t LSeek(int fd, off_t offset, int whence) = 0;
+  virtual int SyncFile(int fd) = 0;
+
+  // Sets the lab2_write_mode of later writes to the file. Returns -1 for an
+  // unknown mode.
+  virtual int SetWriteMode(int fd, int mode) = 0;
+
+  // Sets the logical size of the file, dropping cached blocks past it.
+  virtual int TruncateFile(int fd, off_t length) = 0;
+
+  // Fills st from the underlying file, with st_size set to the logical size.
+  virtual int StatFile(int fd, struct stat* st) = 0;
+
+  // Serves a batch of positional reads. Blocks are deduplicated, hits are
+  // served in one pass and adjacent misses are merged into a single pread.
+  // Fills in each request's result and returns the number of successful ones.
+  virtual ssize_t ReadBatch(lab2_read_req* reqs, size_t count) = 0;
+
+  // Creates a named partition guaranteed min_percent of the capacity, that
+  // may borrow idle capacity up to max_percent. Shares are counted in
+  // resident blocks. Returns -1 if the name is taken or the shares are invalid.
+  virtual int CreatePartition(const std::string& name, size_t min_percent, size_t max_percent) = 0;
+
+  // Loads the blocks of the range and keeps them in the cache until they are
+  // unpinned or the file is closed. Returns -1 without pinning anything if the
+  // pinned blocks would exceed max_pinned_percent of the capacity.
+  virtual int PinRange(int fd, off_t offset, size_t len) = 0;
+  virtual int UnpinRange(int fd, off_t offset, size_t len) = 0;
+
+  // Sets the eviction priority class of the range's blocks, cached or loaded
+  // later. Lower classes are evicted first, in FIFO order within a class.
+  virtual int SetRangePriority(int fd, off_t offset, size_t len, int priority) = 0;
+
+  virtual CacheStats GetStats() = 0;
+};
+
+// FIFO cache of BlockSize-byte blocks. The block size is a template parameter
+// so that the block arithmetic on every access compiles to shifts and masks;
+// the sizes in KBlockSizes are instantiated.
+template <size_t BlockSize>
+class BasicFIFOCache final : public PageCache {
+  static_assert(
+      BlockSize >= KFrameAlignment && (BlockSize & (BlockSize - 1)) == 0,
+      "Blocks are whole O_DIRECT frames, a power of two in size"
+  );
+
 public:
   // Constructor that initializes the cache with a maximum size in number of
   // blocks.
-  explicit FIFOCache(size_t capacity);
+  explicit BasicFIFOCache(size_t capacity, const CacheOptions& options = {});
 
-  ~FIFOCache();
+  ~BasicFIFOCache() override;
 
   // Non-copyable and non-movable.
-  FIFOCache(const FIFOCache&) = delete;
-  FIFOCache& operator=(const FIFOCache&) = delete;
-  FIFOCache(FIFOCache&&) = delete;
-  FIFOCache& operator=(FIFOCache&&) = delete;
+  BasicFIFOCache(const BasicFIFOCache&) = delete;
+  BasicFIFOCache& operator=(const BasicFIFOCache&) = delete;
+  BasicFIFOCache(BasicFIFOCache&&) = delete;
+  BasicFIFOCache& operator=(BasicFIFOCache&&) = delete;
 
-  // API functions
-  int OpenFile(const std::string& path);
-  int CloseFile(int fd);
-  ssize_t ReadFile(int fd, char* buf, size_t size);
-  ssize_t WriteFile(int fd, const char* buf, size_t size);
-  off_t LSeek(int fd, off_t offset, int whence);
-  int SyncFile(int fd);
+  size_t GetBlockSize() const override {
+    return BlockSize;
+  }
+
+  int OpenFile(const std::string& path, const lab2_open_options* options = nullptr) override;
+  int CloseFile(int fd) override;
+  ssize_t ReadFile(int fd, char* buf, size_t size) override;
+  ssize_t WriteFile(int fd, const char* buf, size_t size) override;
+  ssize_t PWriteFile(int fd, const char* buf, size_t size, off_t offset) override;
+  off_t LSeek(int fd, off_t offset, int whence) override;
+  int SyncFile(int fd) override;
+  int SetWriteMode(int fd, int mode) override;
+  int TruncateFile(int fd, off_t length) override;
+  int StatFile(int fd, struct stat* st) override;
+  ssize_t ReadBatch(lab2_read_req* reqs, size_t count) override;
+  int CreatePartition(const std::string& name, size_t min_percent, size_t max_percent) override;
+  int PinRange(int fd, off_t offset, size_t len) override;
+  int UnpinRange(int fd, off_t offset, size_t len) override;
+  int SetRangePriority(int fd, off_t offset, size_t len, int priority) override;
+  CacheStats GetStats() override;
 
 private:
+  // Name of the partition files are opened in by default.
+  static constexpr const char* KDefaultPartition = "default";
+  // Passed to EvictFrom to evict from whichever partition holds the victim.
+  static constexpr size_t KAnyPartition = SIZE_MAX;
+  static constexpr size_t KNumPriorities = LAB2_PRIORITY_HIGH + 1;
+  // Upper bound on max_pinned_percent, leaving room for unpinned blocks.
+  static constexpr size_t KMaxPinnedPercent = 90;
+
+  // Upper bound on blocks merged into one pread of a batch.
+  static constexpr size_t KMaxBatchRunBlocks = 64;
+  // Upper bound on threads issuing the merged preads of a batch, the caller's
+  // included.
+  static constexpr size_t KMaxBatchIoThreads = 8;
+
+  // Reads of at least KBypassBytes bypass the cache, and so do reads of at
+  // least KScanBypassBytes once the file was read sequentially for KScanBytes.
+  static constexpr size_t KBypassBytes = 2 * 1024 * 1024;
+  static constexpr size_t KScanBytes = 4 * 1024 * 1024;
+  static constexpr size_t KScanBypassBytes = 64 * 1024;
+  // Size of the bounce buffer of bypassed reads into unaligned buffers.
+  static constexpr size_t KBounceBufferBytes = 1024 * 1024;
+
+  // Number of version counters shared by all blocks for thread cache invalidation.
+  static constexpr size_t KVersionStripes = 4096;
+  // Misses between two rebalancings of the compressed tier.
+  static constexpr size_t KAdaptWindow = 256;
+  // Share of misses served by the compressed tier above which it grows, and
+  // below which it shrinks, in percent.
+  static constexpr size_t KGrowHitPercent = 20;
+  static constexpr size_t KShrinkHitPercent = 5;
+  // Blocks allowed per frame of capacity, bounding the metadata of blocks
+  // that use shared frames.
+  static constexpr size_t KMaxBlocksPerFrame = 16;
+
+  struct SharedFrame {
+    std::shared_ptr<const AlignedVec> frame;
+    size_t users = 0;
+  };
+
+  // A journaled block written home by a background checkpoint with the lock
+  // released, from a copy taken under the lock.
+  struct CheckpointWrite {
+    uint64_t block_id;
+    int64_t journal_sequence;
+    int os_fd;  // Duplicate of the file's descriptor, valid even if it is closed meanwhile
+    AlignedVec data;
+    bool superseded = false;  // Newer contents were written home, or the block was dropped
+    bool written = false;
+  };
+
+  struct Partition {
+    std::string name;
+    size_t min_percent;
+    size_t max_percent;
+    size_t blocks = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    // Unpinned blocks of each priority class in FIFO order, oldest first:
+    // the eviction candidates. Pinned blocks are in none of the queues.
+    std::array<std::list<Block*>, KNumPriorities> queues{};
+  };
+
   size_t capacity_;
+  CacheOptions options_;
+  const uint64_t id_;  // Unique across all cache instances, tags thread cache entries
   std::list<Block> cache_list_;
   std::unordered_map<uint64_t, std::list<Block>::iterator> map_;
-  std::unordered_map<int, int> open_files_;        // Maps user_fd to OS fd
-  std::unordered_map<int, off_t> file_positions_;  // Maps user_fd to current file position
+  std::unordered_map<int, std::shared_ptr<FileHandle>> open_files_;  // Maps user_fd to its state
+  size_t frames_in_use_ = 0;  // Private frames plus distinct deduplicated frames
+  std::unordered_map<uint64_t, SharedFrame> shared_frames_;  // Deduplicated frames by content hash
   int next_fd_ = 3;  // Starting user-level fd (0,1,2 are standard fds)
+  std::vector<Partition> partitions_;  // The default partition first
+  size_t pinned_blocks_ = 0;
+
+  // Version of each block (striped by block id), bumped whenever a block is
+  // modified or leaves the cache.
+  std::array<std::atomic<uint64_t>, KVersionStripes> block_versions_{};
+  // Hits served from thread caches, without the lock.
+  std::atomic<size_t> thread_cache_hits_{0};
+
+  std::unique_ptr<CompressedTier> compressed_tier_;
+  size_t compressed_frames_ = 0;  // Part of capacity_ lent to the compressed tier
+  size_t window_misses_ = 0;
+  size_t window_compressed_hits_ = 0;
+
+  std::unique_ptr<VictimCache> victim_cache_;
+
+  // Threads issuing the preads of batches, started by the first batch of
+  // several runs.
+  std::unique_ptr<IoPool> io_pool_;
+
+  std::unique_ptr<SharedTier> shared_tier_;
+  size_t shared_hits_ = 0;
+
+  std::unique_ptr<Journal> journal_;
+  std::thread checkpointer_;
+  std::mutex checkpoint_mutex_;
+  std::condition_variable checkpoint_wanted_;
+  bool checkpoint_requested_ = false;
+  bool stop_checkpointer_ = false;
+  // Paths of the files with a commit in the journal. Their blocks written
+  // home are journaled too, so that replay doesn't put older committed
+  // copies over them.
+  std::unordered_set<std::string> committed_paths_;
+  // Blocks of the background checkpoint in progress, indexed by block id.
+  // Their superseded and written flags are guarded by checkpoint_io_mutex_,
+  // held across each write so that newer writes of a block go after it.
+  std::vector<CheckpointWrite> checkpoint_writes_;
+  std::unordered_map<uint64_t, size_t> checkpoint_index_;
+  std::mutex checkpoint_io_mutex_;
+
+  CacheStats stats_;
 
   std::shared_mutex cache_mutex_;  // Mutex for synchronizing access to the cache
 
+  // Takes the cache lock, tracing the time spent waiting for it.
+  std::unique_lock<std::shared_mutex> LockCache();
+
   // Moves a block to the front of the cache list, indicating it was recently
   // used. (В FIFO этот метод не выполняет никаких действий.)
   void Touch(std::list<Block>::iterator it);
@@ -55,12 +404,190 @@ private:
   // Loads a block into the cache from disk
   Block* LoadBlock(uint64_t block_id, const AlignedVec& data);
 
-  // Evicts the oldest block (FIFO) if the cache exceeds capacity
-  void EvictIfNeeded();
+  // Makes room for a block of the partition: evicts from the partition
+  // itself if it reached its maximum share, then from the partitions furthest
+  // above their guaranteed share while the cache exceeds capacity. Pinned
+  // blocks are never evicted.
+  void EvictIfNeeded(size_t partition);
+
+  // Picks the partition to evict from to make room for a block of partition.
+  size_t PickVictimPartition(size_t partition) const;
+
+  // Evicts the oldest unpinned block of the lowest priority class present in
+  // the partition, or in the first partition that has one for KAnyPartition.
+  // Returns false if there is none.
+  bool EvictFrom(size_t partition);
+
+  // Charges a block entering the cache to the partition, with the priority of
+  // its range.
+  void ChargeBlock(Block& block, size_t partition);
+
+  // Adds an unpinned block to the tail of its eviction queue, or removes it.
+  void Enqueue(Block& block);
+  void Dequeue(Block& block);
+
+  // Returns the priority class of the block, from its file's priority ranges.
+  uint8_t PriorityOf(uint64_t block_id) const;
+
+  // Calls visit on each cached block of the file in [first_block, end_block).
+  void ForEachBlockInRange(
+      int fd,
+      uint64_t first_block,
+      uint64_t end_block,
+      const std::function<void(Block&)>& visit
+  );
+
+  // Number of blocks that may be pinned at once.
+  size_t MaxPinnedBlocks() const;
+
+  // Writes back or demotes the block and removes it from the cache.
+  void EvictBlock(std::list<Block>::iterator it);
+
+  // Returns the partition charged for the block, from its file.
+  size_t PartitionOf(uint64_t block_id) const;
+
+  // Bounds of the partition's share of the capacity, in blocks.
+  size_t MinBlocks(size_t partition) const;
+  size_t MaxBlocks(size_t partition) const;
+
+  // Counts a lookup of the block in the cache and partition statistics.
+  void CountAccess(uint64_t block_id, bool hit);
+
+  // Gives the block a private copy of its contents before they are modified
+  // (copy-on-write of shared frames).
+  void MakePrivate(Block& block);
+
+  // Switches a private block whose contents are all zeros to the zero frame.
+  void ShareIfZero(Block& block);
+
+  // Drops the block's claim on its frame and partition, before it leaves the cache.
+  void ReleaseFrame(Block& block);
+
+  // Drops the block's reference to a shared frame.
+  void ReleaseSharedFrame(Block& block);
+
+  // Number of uncompressed blocks the cache may hold.
+  size_t ResidentCapacity() const;
+
+  // Upper bound on the frames lent to the compressed tier.
+  size_t MaxCompressedFrames() const;
+
+  // Fills data with a block missing from the cache, from the compressed tier
+  // if it has it and from disk otherwise. The block is zero-padded to
+  // BlockSize. Returns the number of bytes read, or -1 on a read error.
+  ssize_t FetchBlock(int os_fd, uint64_t block_id, AlignedVec& data);
+
+  // Looks a block missing from the cache up in the compressed tier, the
+  // shared tier and the victim cache. Returns false if none has it.
+  bool FetchFromLowerTiers(uint64_t block_id, AlignedVec& data);
+
+  // Copies size bytes of the block from block_offset into buf straight from
+  // the shared tier. Clean blocks read this way are not admitted, so that
+  // processes sharing the tier do not each keep a private copy. Returns
+  // false if the tier doesn't have the block.
+  bool ReadShared(uint64_t block_id, size_t block_offset, char* buf, size_t size);
+
+  // Records the file's change time in the shared tier after a write home,
+  // which keeps its shared blocks valid for later opens.
+  void UpdateSharedFile(FileHandle& file);
+
+  // Returns the shared tier identity of the block's file.
+  SharedFileKey SharedKeyOf(uint64_t block_id) const;
+
+  // Takes a block out of the compressed tier, accounting the lookup for the
+  // tier adaptation. Returns false if the tier doesn't have it.
+  bool TakeFromCompressedTier(uint64_t block_id, AlignedVec& data);
+
+  // Hands a clean block leaving the cache to the compressed tier or, failing
+  // that, to the victim cache.
+  void DemoteBlock(const Block& block);
+
+  // Moves the capacity split between the tiers towards the one serving misses.
+  void AdaptCompressedTier();
+
+  // Returns the version counter guarding the block in thread caches and in
+  // batch reads issued with the lock released.
+  std::atomic<uint64_t>& BlockVersion(uint64_t block_id);
+
+  // Invalidates thread cache copies of the block, and batch reads of it in
+  // flight. Called with the lock held whenever the block is modified or dropped.
+  void InvalidateThreadCaches(uint64_t block_id);
+
+  // Invalidates every copy of a block that is about to be modified, whether
+  // through the cache or around it: thread caches and every lower tier.
+  void InvalidateCopies(uint64_t block_id);
+
+  // Serves a read entirely from the calling thread's front cache. Returns -1
+  // if any part of it is missing or stale, leaving the file position intact.
+  ssize_t ReadFromThreadCache(int fd, char* buf, size_t size);
+
+  // Copies a block into the calling thread's front cache. Called with the lock held.
+  void RememberInThreadCache(int fd, const std::shared_ptr<FileHandle>& file, const Block& block);
+
+  // Tracks sequential reads of the file and returns how much of a read of
+  // size at position bypasses the cache: its whole blocks if it starts on a
+  // block boundary and is large enough for the file's scan state, else 0.
+  size_t BypassBytes(FileHandle& file, off_t position, size_t size);
+
+  // Reads whole blocks from disk into buf without admitting them, through a
+  // bounce buffer if buf is not aligned to KFrameAlignment as O_DIRECT
+  // requires. The lock is released while the disk is read. Cached blocks
+  // newer than the disk, before or after the read, are copied over the data
+  // read. Returns the number of bytes read, or -1 on a read error or if the
+  // file was closed meanwhile.
+  ssize_t ReadDirect(
+      std::unique_lock<std::shared_mutex>& lock,
+      int fd,
+      std::shared_ptr<FileHandle> file,
+      char* buf,
+      off_t offset,
+      size_t size
+  );
+
+  // Writes buf into the file's blocks at offset, as its write mode says, and
+  // extends the logical size. Returns the number of bytes written, or -1 on
+  // a read or write error.
+  ssize_t WriteAt(int fd, FileHandle& file, const char* buf, size_t size, off_t offset);
 
   // Writes a dirty block back to disk
   int WriteBlockToDisk(Block& block);
 
+  // Writes part of a block that is not cached straight to disk, reading the
+  // rest of the block first if the write doesn't cover it.
+  int WriteAroundCache(
+      int os_fd,
+      uint64_t block_id,
+      const char* buf,
+      size_t block_offset,
+      size_t size
+  );
+
+  // Truncates the file on disk to its logical size, if whole-block writeback
+  // left it longer (or shorter, after a truncate up).
+  int SyncFileSize(FileHandle& file);
+
+  // Appends the file's dirty blocks and a commit record to the journal, then
+  // waits for the commit to be durable with the lock released.
+  int CommitToJournal(std::unique_lock<std::shared_mutex>& lock, int fd, FileHandle& file);
+
+  // Wakes the checkpointer once the journal grows past journal_checkpoint_bytes.
+  void RequestCheckpointIfFull();
+
+  // Writes every journaled block home, syncs the files and empties the journal.
+  int Checkpoint();
+
+  // Checkpoints with the lock released: copies the journaled blocks under the
+  // lock, writes them home and syncs their files without it, then finishes
+  // with Checkpoint, left with the blocks and files written again meanwhile.
+  int CheckpointInBackground();
+
+  // Keeps a background checkpoint from writing the block home, before newer
+  // contents of it are written home or it is dropped from the file.
+  void SupersedeCheckpointWrite(uint64_t block_id);
+
+  // Body of the background thread checkpointing a journal that grew too large.
+  void CheckpointLoop();
+
   // Saves all modified blocks back to disk.
   void Flush();
 
@@ -69,4 +596,23 @@ private:
   void PutBlock(uint64_t block_id, const char* block_data, size_t data_size);
 };
 
+// Block sizes BasicFIFOCache is instantiated for.
+static constexpr std::array<size_t, 3> KBlockSizes = {4096, 16 * 1024, 64 * 1024};
+
+extern template class BasicFIFOCache<4096>;
+extern template class BasicFIFOCache<16 * 1024>;
+extern template class BasicFIFOCache<64 * 1024>;
+
+// The cache of KBlockSize blocks.
+using FIFOCache = BasicFIFOCache<KBlockSize>;
+
+// Creates a cache of capacity blocks of block_size bytes, picking the
+// instantiation at runtime. Returns nullptr if block_size is not one of
+// KBlockSizes; throws like the cache constructor otherwise.
+std::unique_ptr<PageCache> CreateCache(
+    size_t block_size,
+    size_t capacity,
+    const CacheOptions& options = {}
+);
+
 }  // namespace lab2
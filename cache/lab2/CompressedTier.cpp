@@ -0,0 +1,161 @@
+#include "./CompressedTier.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "./Lz.hpp"
+
+namespace lab2 {
+
+CompressedTier::CompressedTier(size_t budget_bytes, size_t block_size)
+    : budget_bytes_(budget_bytes)
+    , max_compressed_size_(block_size * 3 / 4)
+    , slot_granularity_(KSlotGranularity * block_size / KBlockSize)
+    , slab_size_(KSlabSize * block_size / KBlockSize)
+    , compressed_(max_compressed_size_)
+    , free_slots_(max_compressed_size_ / slot_granularity_) {
+}
+
+bool CompressedTier::Put(uint64_t block_id, const char* data, size_t size) {
+  Erase(block_id);
+  if (size == 0) {
+    return false;
+  }
+
+  const size_t compressed_size = LzCompress(data, size, compressed_.data(), compressed_.size());
+  if (compressed_size == 0) {
+    ++stats_.rejected;
+    return false;
+  }
+
+  const size_t size_class = (compressed_size - 1) / slot_granularity_;
+  if (SlotSize(size_class) > budget_bytes_) {
+    return false;
+  }
+  while (stats_.used_bytes + SlotSize(size_class) > budget_bytes_) {
+    EvictOldest();
+  }
+
+  const auto [slot, slab] = AllocateSlot(size_class);
+  std::memcpy(slot, compressed_.data(), compressed_size);
+  fifo_.push_back(block_id);
+  entries_[block_id] = {slot, slab, size_class, compressed_size, size, std::prev(fifo_.end())};
+
+  stats_.used_bytes += SlotSize(size_class);
+  ++stats_.entries;
+  ++stats_.stored;
+  return true;
+}
+
+bool CompressedTier::Take(uint64_t block_id, AlignedVec& data) {
+  auto it = entries_.find(block_id);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  const Entry& entry = it->second;
+  data.resize(entry.original_size);
+  const ssize_t size = LzDecompress(entry.slot, entry.compressed_size, data.data(), data.size());
+  Remove(it);
+  if (size != static_cast<ssize_t>(data.size())) {
+    return false;  // Corrupt entry, fall back to disk
+  }
+
+  ++stats_.hits;
+  return true;
+}
+
+void CompressedTier::Erase(uint64_t block_id) {
+  auto it = entries_.find(block_id);
+  if (it != entries_.end()) {
+    Remove(it);
+  }
+}
+
+void CompressedTier::EraseFile(int fd) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    auto next = std::next(it);
+    if ((it->first >> KFdOffset) == static_cast<uint64_t>(fd)) {
+      Remove(it);
+    }
+    it = next;
+  }
+}
+
+void CompressedTier::SetBudget(size_t budget_bytes) {
+  budget_bytes_ = budget_bytes;
+  while (stats_.used_bytes > budget_bytes_) {
+    EvictOldest();
+  }
+}
+
+std::pair<char*, size_t> CompressedTier::AllocateSlot(size_t size_class) {
+  auto& free_slots = free_slots_[size_class];
+  if (free_slots.empty()) {
+    // Carve a new slab into slots of this class, reusing a released index if any
+    auto slab_it = std::find_if(slabs_.begin(), slabs_.end(), [](const Slab& slab) {
+      return slab.memory == nullptr;
+    });
+    if (slab_it == slabs_.end()) {
+      slab_it = slabs_.insert(slabs_.end(), Slab{});
+    }
+    slab_it->memory = std::make_unique<char[]>(slab_size_);
+    slab_it->size_class = size_class;
+    slab_it->used_slots = 0;
+
+    const auto slab_index = static_cast<size_t>(slab_it - slabs_.begin());
+    const size_t slot_size = SlotSize(size_class);
+    for (size_t offset = 0; offset + slot_size <= slab_size_; offset += slot_size) {
+      free_slots.emplace_back(slab_it->memory.get() + offset, slab_index);
+    }
+  }
+
+  const auto slot = free_slots.back();
+  free_slots.pop_back();
+  ++slabs_[slot.second].used_slots;
+  return slot;
+}
+
+void CompressedTier::FreeSlot(char* slot, size_t slab_index, size_t size_class) {
+  Slab& slab = slabs_[slab_index];
+  auto& free_slots = free_slots_[size_class];
+  if (--slab.used_slots > 0) {
+    free_slots.emplace_back(slot, slab_index);
+    return;
+  }
+
+  // The slab is empty: forget its free slots and give the memory back
+  std::erase_if(free_slots, [slab_index](const auto& free_slot) {
+    return free_slot.second == slab_index;
+  });
+  slab.memory.reset();
+}
+
+void CompressedTier::Remove(std::unordered_map<uint64_t, Entry>::iterator it) {
+  const Entry& entry = it->second;
+  FreeSlot(entry.slot, entry.slab, entry.size_class);
+  fifo_.erase(entry.fifo_it);
+  stats_.used_bytes -= SlotSize(entry.size_class);
+  --stats_.entries;
+  entries_.erase(it);
+}
+
+void CompressedTier::EvictOldest() {
+  auto it = entries_.find(fifo_.front());
+  if (eviction_handler_) {
+    const Entry& entry = it->second;
+    AlignedVec data(entry.original_size);
+    const ssize_t size =
+        LzDecompress(entry.slot, entry.compressed_size, data.data(), data.size());
+    if (size == static_cast<ssize_t>(data.size())) {
+      eviction_handler_(it->first, data.data(), data.size());
+    }
+  }
+  Remove(it);
+  ++stats_.evicted;
+}
+
+}  // namespace lab2
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./Block.hpp"
+
+namespace lab2 {
+
+// In-memory tier holding clean blocks compressed with LzCompress. Compressed
+// blocks live in slots of a slab arena, one slab per size class; slabs are
+// released once all of their slots are free. Entries are evicted in FIFO
+// order to stay within a byte budget, optionally handing them on to a lower tier.
+// Size classes and slabs scale with the block size, so that every block size
+// gets the same number of classes and of largest slots per slab.
+class CompressedTier {
+public:
+  // Sizes for KBlockSize blocks. Blocks that don't compress to 3/4 of their
+  // size or less are rejected.
+  static constexpr size_t KSlotGranularity = 256;
+  static constexpr size_t KSlabSize = 64 * 1024;
+
+  struct Stats {
+    size_t entries = 0;
+    size_t used_bytes = 0;
+    size_t stored = 0;
+    size_t rejected = 0;  // Incompressible blocks
+    size_t hits = 0;
+    size_t evicted = 0;
+  };
+
+  // Receives the decompressed contents of blocks evicted from the tier.
+  using EvictionHandler = std::function<void(uint64_t block_id, const char* data, size_t size)>;
+
+  explicit CompressedTier(size_t budget_bytes, size_t block_size = KBlockSize);
+
+  void SetEvictionHandler(EvictionHandler handler) {
+    eviction_handler_ = std::move(handler);
+  }
+
+  // Compresses and stores a clean block, evicting older entries if needed.
+  // Returns false if the block is incompressible or doesn't fit the budget.
+  bool Put(uint64_t block_id, const char* data, size_t size);
+
+  // Removes the block from the tier and decompresses it into data. Returns
+  // false if the block is not in the tier.
+  bool Take(uint64_t block_id, AlignedVec& data);
+
+  // Drops the block, if present.
+  void Erase(uint64_t block_id);
+
+  // Drops all blocks of a user fd.
+  void EraseFile(int fd);
+
+  // Changes the byte budget, evicting entries that no longer fit.
+  void SetBudget(size_t budget_bytes);
+
+  size_t Budget() const {
+    return budget_bytes_;
+  }
+
+  // Largest compressed size of a block stored in the tier.
+  size_t MaxCompressedSize() const {
+    return max_compressed_size_;
+  }
+
+  const Stats& GetStats() const {
+    return stats_;
+  }
+
+private:
+  struct Slab {
+    std::unique_ptr<char[]> memory;
+    size_t size_class;
+    size_t used_slots;
+  };
+
+  struct Entry {
+    char* slot;
+    size_t slab;
+    size_t size_class;
+    size_t compressed_size;
+    size_t original_size;
+    std::list<uint64_t>::iterator fifo_it;
+  };
+
+  // Returns a free slot of the class and the index of its slab.
+  std::pair<char*, size_t> AllocateSlot(size_t size_class);
+
+  void FreeSlot(char* slot, size_t slab_index, size_t size_class);
+
+  void Remove(std::unordered_map<uint64_t, Entry>::iterator it);
+
+  // Evicts the oldest entry, passing it to the eviction handler.
+  void EvictOldest();
+
+  size_t SlotSize(size_t size_class) const {
+    return (size_class + 1) * slot_granularity_;
+  }
+
+  size_t budget_bytes_;
+  size_t max_compressed_size_;
+  size_t slot_granularity_;
+  size_t slab_size_;
+  std::vector<char> compressed_;  // Scratch buffer of Put
+  std::unordered_map<uint64_t, Entry> entries_;
+  std::list<uint64_t> fifo_;  // Oldest entry first
+  std::vector<Slab> slabs_;   // Released slabs keep their index with null memory
+  std::vector<std::vector<std::pair<char*, size_t>>> free_slots_;  // Slot and its slab, per class
+  Stats stats_;
+  EvictionHandler eviction_handler_;
+};
+
+}  // namespace lab2
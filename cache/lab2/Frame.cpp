@@ -0,0 +1,63 @@
+#include "./Frame.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace lab2 {
+
+bool IsZeroFrame(const char* data, size_t size) {
+  size_t pos = 0;
+
+#if defined(__SSE2__)
+  // OR four 16-byte lanes per step and check them at once
+  const __m128i zero = _mm_setzero_si128();
+  for (; pos + 64 <= size; pos += 64) {
+    const auto* lanes = reinterpret_cast<const __m128i*>(data + pos);
+    const __m128i acc = _mm_or_si128(
+        _mm_or_si128(_mm_loadu_si128(lanes), _mm_loadu_si128(lanes + 1)),
+        _mm_or_si128(_mm_loadu_si128(lanes + 2), _mm_loadu_si128(lanes + 3))
+    );
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF) {
+      return false;
+    }
+  }
+#endif
+
+  for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+    uint64_t word = 0;
+    std::memcpy(&word, data + pos, sizeof(word));
+    if (word != 0) {
+      return false;
+    }
+  }
+  for (; pos < size; ++pos) {
+    if (data[pos] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t HashFrame(const char* data, size_t size) {
+  constexpr uint64_t KMultiplier = 0x9E3779B97F4A7C15ULL;
+
+  uint64_t hash = size * KMultiplier;
+  size_t pos = 0;
+  for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+    uint64_t word = 0;
+    std::memcpy(&word, data + pos, sizeof(word));
+    hash = (hash ^ word) * KMultiplier;
+    hash ^= hash >> 29;
+  }
+  for (; pos < size; ++pos) {
+    hash = (hash ^ static_cast<uint8_t>(data[pos])) * KMultiplier;
+  }
+  return hash ^ (hash >> 32);
+}
+
+}  // namespace lab2
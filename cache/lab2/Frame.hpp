@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "./Block.hpp"
+
+namespace lab2 {
+
+// Returns true if all bytes of data are zero. Vectorized with SSE2 where available.
+bool IsZeroFrame(const char* data, size_t size);
+
+// Returns the read-only all-zero frame shared by every all-zero block of Size bytes.
+template <size_t Size>
+const std::shared_ptr<const AlignedVec>& ZeroFrame() {
+  static const std::shared_ptr<const AlignedVec> frame =
+      std::make_shared<const AlignedVec>(Size, 0);
+  return frame;
+}
+
+// Hashes frame contents for deduplication. Equal hashes must still be
+// confirmed by comparing the contents.
+uint64_t HashFrame(const char* data, size_t size);
+
+}  // namespace lab2
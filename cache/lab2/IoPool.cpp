@@ -0,0 +1,90 @@
+#include "./IoPool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace lab2 {
+
+IoPool::IoPool(size_t num_threads) {
+  threads_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&IoPool::WorkerLoop, this);
+  }
+}
+
+IoPool::~IoPool() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  job_added_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void IoPool::Run(size_t count, const std::function<void(size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  Job job;
+  job.task = &task;
+  job.count = count;
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(&job);
+  }
+  job_added_.notify_all();
+
+  Work(job);
+
+  // The job lives on this stack, so wait for the pool threads to let it go
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_done_.wait(lock, [&job] {
+    return job.done == job.count && job.workers == 0;
+  });
+  std::erase(jobs_, &job);
+}
+
+void IoPool::Work(Job& job) {
+  size_t finished = 0;
+  for (size_t i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+    (*job.task)(i);
+    ++finished;
+  }
+
+  if (finished > 0) {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    job.done += finished;
+  }
+}
+
+void IoPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    job_added_.wait(lock, [this] {
+      return stop_ || !jobs_.empty();
+    });
+    if (stop_) {
+      return;
+    }
+
+    Job* job = jobs_.front();
+    if (job->next.load() >= job->count) {
+      jobs_.pop_front();  // Every index is claimed, its caller waits for the rest
+      continue;
+    }
+
+    ++job->workers;
+    lock.unlock();
+    Work(*job);
+    lock.lock();
+    --job->workers;
+    job_done_.notify_all();
+  }
+}
+
+}  // namespace lab2
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lab2 {
+
+// Fixed pool of threads issuing blocking I/O on behalf of callers, started
+// once instead of per request. Several callers may run jobs at once; each
+// caller works on its own job too, so a job makes progress even while the
+// pool is busy with others.
+class IoPool {
+public:
+  explicit IoPool(size_t num_threads);
+
+  ~IoPool();
+
+  IoPool(const IoPool&) = delete;
+  IoPool& operator=(const IoPool&) = delete;
+  IoPool(IoPool&&) = delete;
+  IoPool& operator=(IoPool&&) = delete;
+
+  // Calls task(i) for every i in [0, count) on the pool's threads and the
+  // calling one, and returns once all calls are done.
+  void Run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+  struct Job {
+    const std::function<void(size_t)>* task;
+    size_t count;
+    std::atomic<size_t> next{0};  // Next index to claim
+    size_t done = 0;              // Calls finished, guarded by mutex_
+    size_t workers = 0;           // Pool threads holding the job, guarded by mutex_
+  };
+
+  // Claims and runs indexes of the job until none is left.
+  void Work(Job& job);
+
+  void WorkerLoop();
+
+  std::vector<std::thread> threads_;
+  std::deque<Job*> jobs_;  // Jobs with indexes left to claim, oldest first
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable job_added_;
+  std::condition_variable job_done_;
+};
+
+}  // namespace lab2
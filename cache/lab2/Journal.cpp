@@ -0,0 +1,254 @@
+#include "./Journal.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./Block.hpp"
+#include "./Frame.hpp"
+
+namespace lab2 {
+
+Journal::Journal(const std::string& path, size_t block_size)
+    : block_size_(block_size) {
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ == -1) {
+    throw std::runtime_error("Failed to open journal " + path);
+  }
+
+  struct stat stat_data = {};
+  if (fstat(fd_, &stat_data) == -1) {
+    close(fd_);
+    throw std::runtime_error("Failed to open journal " + path);
+  }
+  size_ = stat_data.st_size;
+}
+
+Journal::~Journal() {
+  close(fd_);
+}
+
+ssize_t Journal::Replay() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  std::vector<char> contents(size_);
+  if (pread(fd_, contents.data(), contents.size(), 0) != static_cast<ssize_t>(contents.size())) {
+    return -1;
+  }
+
+  // Blocks of each file waiting for its next commit record
+  struct PendingBlock {
+    uint64_t block_num;
+    const char* data;
+    size_t size;
+  };
+  std::unordered_map<std::string, std::vector<PendingBlock>> pending;
+  std::unordered_map<std::string, int> files;
+  ssize_t replayed = 0;
+  bool failed = false;
+
+  size_t offset = 0;
+  while (!failed && offset + sizeof(RecordHeader) <= contents.size()) {
+    RecordHeader header;
+    std::memcpy(&header, contents.data() + offset, sizeof(header));
+    const size_t record_size = sizeof(header) + header.path_size + header.data_size;
+    if (header.magic != KRecordMagic || record_size > contents.size() - offset) {
+      break;  // Torn or garbage tail
+    }
+
+    // Verify the checksum with the field zeroed, as it was computed
+    const uint64_t checksum = header.checksum;
+    header.checksum = 0;
+    std::memcpy(contents.data() + offset, &header, sizeof(header));
+    if (HashFrame(contents.data() + offset, record_size) != checksum) {
+      break;
+    }
+
+    const char* payload = contents.data() + offset + sizeof(header);
+    const std::string path(payload, header.path_size);
+    const char* data = payload + header.path_size;
+    offset += record_size;
+
+    if (header.type == RecordType::Block && header.data_size > 0) {
+      pending[path].push_back({header.value, data, header.data_size});
+      continue;
+    }
+    if (header.type != RecordType::Commit) {
+      break;
+    }
+
+    auto file_it = files.find(path);
+    if (file_it == files.end()) {
+      const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+      if (fd == -1) {
+        failed = true;
+        break;
+      }
+      file_it = files.emplace(path, fd).first;
+    }
+    for (const PendingBlock& block : pending[path]) {
+      const auto block_offset = static_cast<off_t>(block.block_num * block.size);
+      const ssize_t written = pwrite(file_it->second, block.data, block.size, block_offset);
+      if (written != static_cast<ssize_t>(block.size)) {
+        failed = true;
+      }
+    }
+    pending.erase(path);
+    if (ftruncate(file_it->second, static_cast<off_t>(header.value)) == -1) {
+      failed = true;
+    }
+    ++replayed;
+  }
+
+  for (const auto& [path, fd] : files) {
+    if (fsync(fd) == -1) {
+      failed = true;
+    }
+    close(fd);
+  }
+  if (failed) {
+    return -1;
+  }
+
+  if (ftruncate(fd_, 0) == -1 || fsync(fd_) == -1) {
+    return -1;
+  }
+  size_ = 0;
+  return replayed;
+}
+
+int Journal::Append(const std::string& path, const std::vector<BlockRecord>& blocks) {
+  std::vector<char> buffer;
+  for (const auto& block : blocks) {
+    AppendRecord(buffer, RecordType::Block, block.block_num, path, block.data, block_size_);
+  }
+
+  const std::lock_guard<std::mutex> lock(mutex_);
+  return WriteLocked(buffer);
+}
+
+int64_t Journal::Commit(
+    const std::string& path,
+    const std::vector<BlockRecord>& blocks,
+    off_t file_size
+) {
+  std::vector<char> buffer;
+  for (const auto& block : blocks) {
+    AppendRecord(buffer, RecordType::Block, block.block_num, path, block.data, block_size_);
+  }
+  AppendRecord(buffer, RecordType::Commit, file_size, path, nullptr, 0);
+
+  const std::lock_guard<std::mutex> lock(mutex_);
+  if (WriteLocked(buffer) == -1) {
+    return -1;
+  }
+  ++stats_.commits;
+  return ++last_sequence_;
+}
+
+int Journal::WaitDurable(int64_t sequence) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (durable_sequence_ < sequence) {
+    if (syncing_) {
+      synced_.wait(lock);
+      continue;
+    }
+
+    // Become the leader and sync every commit appended so far
+    syncing_ = true;
+    const int64_t target = last_sequence_;
+    lock.unlock();
+    const int result = fdatasync(fd_);
+    lock.lock();
+    syncing_ = false;
+    ++stats_.syncs;
+    if (result == 0) {
+      durable_sequence_ = std::max(durable_sequence_, target);
+    }
+    synced_.notify_all();
+    if (result == -1) {
+      return -1;  // fdatasync failed, waiters will retry
+    }
+  }
+  return 0;
+}
+
+int Journal::Reset() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+  // Synced, so that a crash cannot replay records superseded by later home writes
+  if (ftruncate(fd_, 0) == -1 || fsync(fd_) == -1) {
+    return -1;
+  }
+  size_ = 0;
+
+  // Every commit is now durable in its home file
+  durable_sequence_ = last_sequence_;
+  synced_.notify_all();
+  return 0;
+}
+
+size_t Journal::Size() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+Journal::Stats Journal::GetStats() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void Journal::AppendRecord(
+    std::vector<char>& buffer,
+    RecordType type,
+    uint64_t value,
+    const std::string& path,
+    const char* data,
+    size_t data_size
+) {
+  const RecordHeader header = {
+      KRecordMagic,
+      type,
+      value,
+      static_cast<uint32_t>(path.size()),
+      static_cast<uint32_t>(data_size),
+      0,
+  };
+
+  const size_t begin = buffer.size();
+  buffer.resize(begin + sizeof(header) + path.size() + data_size);
+  char* record = buffer.data() + begin;
+  std::memcpy(record, &header, sizeof(header));
+  std::memcpy(record + sizeof(header), path.data(), path.size());
+  if (data_size > 0) {
+    std::memcpy(record + sizeof(header) + path.size(), data, data_size);
+  }
+
+  const uint64_t checksum = HashFrame(record, buffer.size() - begin);
+  std::memcpy(record + offsetof(RecordHeader, checksum), &checksum, sizeof(checksum));
+}
+
+int Journal::WriteLocked(const std::vector<char>& buffer) {
+  size_t written = 0;
+  while (written < buffer.size()) {
+    const ssize_t result = pwrite(
+        fd_, buffer.data() + written, buffer.size() - written, static_cast<off_t>(size_ + written)
+    );
+    if (result <= 0) {
+      return -1;  // Write error, the partial record fails its checksum on replay
+    }
+    written += result;
+  }
+  size_ += written;
+  return 0;
+}
+
+}  // namespace lab2
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "./Block.hpp"
+
+namespace lab2 {
+
+// Write-ahead journal shared by all files of a cache. A sync appends the
+// file's dirty blocks and a commit record sequentially, so committing costs a
+// single fdatasync of the journal instead of random writes and an fsync of the
+// file. Concurrent commits share one fdatasync. Records name files by path, so
+// committed transactions can be replayed into them after a crash; records
+// after the last commit of a file are ignored.
+class Journal {
+public:
+  // A block to append, of the journal's block size.
+  struct BlockRecord {
+    uint64_t block_num;
+    const char* data;
+  };
+
+  struct Stats {
+    size_t commits = 0;
+    size_t syncs = 0;  // fdatasyncs of the journal, shared by grouped commits
+  };
+
+  // Opens (or creates) the journal at path, keeping its contents for Replay,
+  // for blocks of block_size bytes. Records carry their size, so Replay also
+  // handles blocks appended with another block size. Throws
+  // std::runtime_error if the file cannot be opened.
+  explicit Journal(const std::string& path, size_t block_size = KBlockSize);
+
+  ~Journal();
+
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+  Journal(Journal&&) = delete;
+  Journal& operator=(Journal&&) = delete;
+
+  // Writes the blocks of every committed transaction to their files, syncs
+  // them and empties the journal. Returns the number of transactions
+  // replayed, or -1 on error.
+  ssize_t Replay();
+
+  // Appends blocks written home before their file is committed, so that a
+  // later commit of the file replays them over older committed copies.
+  int Append(const std::string& path, const std::vector<BlockRecord>& blocks);
+
+  // Appends the blocks and a commit record setting the file size. Returns
+  // the sequence number to wait for, or -1 on a write error.
+  int64_t Commit(const std::string& path, const std::vector<BlockRecord>& blocks, off_t file_size);
+
+  // Waits until the commit is on stable storage. One caller syncs the journal
+  // on behalf of every commit appended so far while the others wait.
+  int WaitDurable(int64_t sequence);
+
+  // Empties the journal, once all committed blocks are synced at home.
+  int Reset();
+
+  // Bytes appended since the last reset.
+  size_t Size();
+
+  Stats GetStats();
+
+private:
+  enum class RecordType : uint32_t {
+    Block = 1,
+    Commit = 2,
+  };
+
+  struct RecordHeader {
+    uint32_t magic;
+    RecordType type;
+    uint64_t value;  // Block number, or file size of a commit
+    uint32_t path_size;
+    uint32_t data_size;
+    uint64_t checksum;  // Of the whole record, computed with this field zeroed
+  };
+
+  static constexpr uint32_t KRecordMagic = 0x4C324A52;  // "L2JR"
+
+  static void AppendRecord(
+      std::vector<char>& buffer,
+      RecordType type,
+      uint64_t value,
+      const std::string& path,
+      const char* data,
+      size_t data_size
+  );
+
+  // Writes the buffer at the end of the journal. Called with the mutex held.
+  int WriteLocked(const std::vector<char>& buffer);
+
+  int fd_ = -1;
+  size_t block_size_;
+  size_t size_ = 0;
+  int64_t last_sequence_ = 0;     // Of the last appended commit
+  int64_t durable_sequence_ = 0;  // Of the last commit on stable storage
+  bool syncing_ = false;
+  Stats stats_;
+
+  std::mutex mutex_;
+  std::condition_variable synced_;
+};
+
+}  // namespace lab2
@@ -0,0 +1,196 @@
+#include "./Lz.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace lab2 {
+
+namespace {
+
+constexpr size_t KMinMatch = 4;
+constexpr size_t KHashBits = 12;
+constexpr size_t KMaxOffset = 0xFFFF;
+constexpr unsigned KNibbleMax = 15;
+
+uint32_t Load32(const char* ptr) {
+  uint32_t value = 0;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+size_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - KHashBits);
+}
+
+class Writer {
+public:
+  Writer(char* dst, size_t capacity) : dst_(dst), capacity_(capacity) {
+  }
+
+  bool Put(uint8_t byte) {
+    if (size_ >= capacity_) {
+      return false;
+    }
+    dst_[size_++] = static_cast<char>(byte);
+    return true;
+  }
+
+  bool PutLength(size_t length) {
+    for (; length >= 255; length -= 255) {
+      if (!Put(255)) {
+        return false;
+      }
+    }
+    return Put(static_cast<uint8_t>(length));
+  }
+
+  bool PutBytes(const char* src, size_t count) {
+    if (capacity_ - size_ < count) {
+      return false;
+    }
+    std::memcpy(dst_ + size_, src, count);
+    size_ += count;
+    return true;
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+private:
+  char* dst_;
+  size_t capacity_;
+  size_t size_ = 0;
+};
+
+// Emits one group. A match_length of 0 marks the final, literals-only group.
+bool EmitSequence(
+    Writer& out,
+    const char* literals,
+    size_t literal_length,
+    size_t offset,
+    size_t match_length
+) {
+  const size_t literal_nibble = std::min<size_t>(literal_length, KNibbleMax);
+  const size_t match_code = match_length == 0 ? 0 : match_length - KMinMatch;
+  const size_t match_nibble = std::min<size_t>(match_code, KNibbleMax);
+  if (!out.Put(static_cast<uint8_t>((literal_nibble << 4) | match_nibble))) {
+    return false;
+  }
+  if (literal_nibble == KNibbleMax && !out.PutLength(literal_length - KNibbleMax)) {
+    return false;
+  }
+  if (!out.PutBytes(literals, literal_length)) {
+    return false;
+  }
+  if (match_length == 0) {
+    return true;
+  }
+  if (!out.Put(offset & 0xFF) || !out.Put(offset >> 8)) {
+    return false;
+  }
+  return match_nibble != KNibbleMax || out.PutLength(match_code - KNibbleMax);
+}
+
+// Reads a 255-terminated length continuation. Returns false on truncated input.
+bool ReadLength(const char* src, size_t src_size, size_t& pos, size_t& length) {
+  uint8_t byte = 255;
+  while (byte == 255) {
+    if (pos >= src_size) {
+      return false;
+    }
+    byte = static_cast<uint8_t>(src[pos++]);
+    length += byte;
+  }
+  return true;
+}
+
+}  // namespace
+
+size_t LzCompress(const char* src, size_t src_size, char* dst, size_t dst_capacity) {
+  std::array<int32_t, 1U << KHashBits> table;
+  table.fill(-1);
+
+  Writer out(dst, dst_capacity);
+  size_t pos = 0;
+  size_t anchor = 0;
+
+  while (pos + KMinMatch <= src_size) {
+    const uint32_t sequence = Load32(src + pos);
+    const size_t hash = Hash(sequence);
+    const int32_t candidate = table[hash];
+    table[hash] = static_cast<int32_t>(pos);
+
+    if (candidate < 0 || pos - candidate > KMaxOffset || Load32(src + candidate) != sequence) {
+      ++pos;
+      continue;
+    }
+
+    size_t match_length = KMinMatch;
+    const size_t max_length = src_size - pos;
+    while (match_length < max_length && src[candidate + match_length] == src[pos + match_length]) {
+      ++match_length;
+    }
+
+    if (!EmitSequence(out, src + anchor, pos - anchor, pos - candidate, match_length)) {
+      return 0;
+    }
+    pos += match_length;
+    anchor = pos;
+  }
+
+  if (anchor < src_size && !EmitSequence(out, src + anchor, src_size - anchor, 0, 0)) {
+    return 0;
+  }
+  return out.Size();
+}
+
+ssize_t LzDecompress(const char* src, size_t src_size, char* dst, size_t dst_capacity) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < src_size) {
+    const auto token = static_cast<uint8_t>(src[in++]);
+
+    size_t literal_length = token >> 4;
+    if (literal_length == KNibbleMax && !ReadLength(src, src_size, in, literal_length)) {
+      return -1;
+    }
+    if (src_size - in < literal_length || dst_capacity - out < literal_length) {
+      return -1;
+    }
+    std::memcpy(dst + out, src + in, literal_length);
+    in += literal_length;
+    out += literal_length;
+
+    if (in == src_size) {
+      break;  // Final literals-only group
+    }
+
+    if (src_size - in < 2) {
+      return -1;
+    }
+    const size_t offset = static_cast<uint8_t>(src[in]) |
+                          (static_cast<size_t>(static_cast<uint8_t>(src[in + 1])) << 8);
+    in += 2;
+    size_t match_length = token & KNibbleMax;
+    if (match_length == KNibbleMax && !ReadLength(src, src_size, in, match_length)) {
+      return -1;
+    }
+    match_length += KMinMatch;
+    if (offset == 0 || offset > out || dst_capacity - out < match_length) {
+      return -1;
+    }
+
+    // Byte by byte, as the match may overlap the bytes it produces
+    for (size_t i = 0; i < match_length; ++i, ++out) {
+      dst[out] = dst[out - offset];
+    }
+  }
+
+  return static_cast<ssize_t>(out);
+}
+
+}  // namespace lab2
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+
+namespace lab2 {
+
+// Minimal byte-oriented LZ77 codec in the spirit of LZ4. The stream is a
+// sequence of (token, literals, offset, match) groups: the token holds the
+// literal length in its high nibble and the match length minus 4 in its low
+// nibble, a nibble of 15 is continued by 255-terminated extra bytes, and the
+// offset is 2 bytes little-endian. The last group has literals only.
+
+// Compresses src into dst. Returns the compressed size, or 0 if the result
+// does not fit into dst_capacity bytes (e.g. the data is incompressible).
+size_t LzCompress(const char* src, size_t src_size, char* dst, size_t dst_capacity);
+
+// Decompresses src into dst. Returns the decompressed size, or -1 if the
+// input is corrupt or does not fit into dst_capacity bytes.
+ssize_t LzDecompress(const char* src, size_t src_size, char* dst, size_t dst_capacity);
+
+}  // namespace lab2
@@ -0,0 +1,496 @@
+#include "./SharedTier.hpp"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "./Frame.hpp"
+
+namespace lab2 {
+
+namespace {
+
+constexpr uint64_t KSegmentMagic = 0x4C32534841524532;  // "L2SHARE2"
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+bool SameFile(const SharedFileKey& lhs, const SharedFileKey& rhs) {
+  return lhs.dev == rhs.dev && lhs.ino == rhs.ino;
+}
+
+}  // namespace
+
+// Start of the segment, describing its geometry. Set up by the creating
+// process before it publishes ready.
+struct SharedTier::Header {
+  uint64_t magic;
+  uint64_t block_size;
+  uint64_t slots_per_shard;
+  uint64_t buckets_per_shard;
+  pthread_mutex_t files_mutex;
+  std::atomic<uint32_t> ready;
+};
+
+struct SharedTier::Shard {
+  pthread_mutex_t mutex;
+  uint64_t hand;       // Next slot replaced, in FIFO order
+  uint64_t write_seq;  // Bumped by every Publish and Erase, invalidating fill tokens
+  uint64_t entries;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t fills;
+  uint64_t evictions;
+  uint64_t recoveries;
+};
+
+SharedTier::FileTableLock::FileTableLock(SharedTier& tier)
+    : header_(tier.HeaderOf()) {
+  const int result = pthread_mutex_lock(&header_.files_mutex);
+  if (result == EOWNERDEAD) {
+    // Every file is then treated as modified on its next open
+    std::fill_n(tier.FileTable(), KFileEntries, FileEntry{});
+    pthread_mutex_consistent(&header_.files_mutex);
+  } else if (result != 0) {
+    return;
+  }
+  locked_ = true;
+}
+
+SharedTier::FileTableLock::~FileTableLock() {
+  if (locked_) {
+    pthread_mutex_unlock(&header_.files_mutex);
+  }
+}
+
+SharedTier::ShardLock::ShardLock(SharedTier& tier, size_t shard)
+    : shard_(tier.ShardAt(shard)) {
+  const int result = pthread_mutex_lock(&shard_.mutex);
+  if (result == EOWNERDEAD) {
+    // The previous holder died, possibly in the middle of an update
+    tier.Recover(shard);
+    ++shard_.recoveries;
+    pthread_mutex_consistent(&shard_.mutex);
+  } else if (result != 0) {
+    return;  // Not recoverable, the shard is skipped
+  }
+  locked_ = true;
+}
+
+SharedTier::ShardLock::~ShardLock() {
+  if (locked_) {
+    pthread_mutex_unlock(&shard_.mutex);
+  }
+}
+
+SharedTier::SharedTier(const std::string& name, size_t capacity, size_t block_size)
+    : block_size_(block_size) {
+  slots_per_shard_ = std::max<size_t>(1, (capacity + KShards - 1) / KShards);
+  buckets_per_shard_ = 1;
+  while (buckets_per_shard_ < slots_per_shard_) {
+    buckets_per_shard_ *= 2;
+  }
+
+  shards_offset_ = AlignUp(sizeof(Header), 64);
+  files_offset_ = shards_offset_ + KShards * AlignUp(sizeof(Shard), 64);
+  slots_offset_ = files_offset_ + KFileEntries * sizeof(FileEntry);
+  buckets_offset_ = slots_offset_ + KShards * slots_per_shard_ * sizeof(Slot);
+  frames_offset_ =
+      AlignUp(buckets_offset_ + KShards * buckets_per_shard_ * sizeof(int32_t), KFrameAlignment);
+  size_ = frames_offset_ + KShards * slots_per_shard_ * block_size_;
+
+  // A segment whose creator died before initializing it never becomes
+  // ready: remove it and create it again
+  if (!Attach(name)) {
+    shm_unlink(name.c_str());
+    if (!Attach(name)) {
+      throw std::runtime_error("Shared tier " + name + " is not initialized");
+    }
+  }
+}
+
+bool SharedTier::Attach(const std::string& name) {
+  // Exactly one process creates and initializes the segment
+  bool creator = true;
+  fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd_ == -1 && errno == EEXIST) {
+    creator = false;
+    fd_ = shm_open(name.c_str(), O_RDWR, 0);
+  }
+  if (fd_ == -1) {
+    throw std::runtime_error("Failed to open shared tier " + name);
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + KAttachTimeout;
+  if (creator) {
+    if (ftruncate(fd_, static_cast<off_t>(size_)) == -1) {
+      close(fd_);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("Failed to size shared tier " + name);
+    }
+  } else {
+    // Wait for the creator to size the segment
+    struct stat stat_data = {};
+    while (fstat(fd_, &stat_data) == 0 && stat_data.st_size == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (stat_data.st_size == 0) {
+      close(fd_);
+      return false;  // Abandoned before it was sized
+    }
+    if (stat_data.st_size != static_cast<off_t>(size_)) {
+      close(fd_);
+      throw std::runtime_error("Shared tier " + name + " has another geometry");
+    }
+  }
+
+  void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd_);
+    throw std::runtime_error("Failed to map shared tier " + name);
+  }
+  base_ = static_cast<char*>(mapping);
+  auto* header = reinterpret_cast<Header*>(base_);
+
+  if (creator) {
+    // The segment starts zeroed
+    header->magic = KSegmentMagic;
+    header->block_size = block_size_;
+    header->slots_per_shard = slots_per_shard_;
+    header->buckets_per_shard = buckets_per_shard_;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->files_mutex, &attr);
+    for (size_t shard = 0; shard < KShards; ++shard) {
+      pthread_mutex_init(&ShardAt(shard).mutex, &attr);
+      for (size_t slot = 0; slot < slots_per_shard_; ++slot) {
+        SlotAt(shard, slot).next = -1;
+      }
+      std::fill_n(Buckets(shard), buckets_per_shard_, -1);
+    }
+    pthread_mutexattr_destroy(&attr);
+    header->ready.store(1, std::memory_order_release);
+    return true;
+  }
+
+  while (header->ready.load(std::memory_order_acquire) == 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (header->ready.load(std::memory_order_acquire) == 0) {
+    munmap(base_, size_);
+    close(fd_);
+    return false;  // Abandoned before it was initialized
+  }
+  if (header->magic != KSegmentMagic || header->block_size != block_size_ ||
+      header->slots_per_shard != slots_per_shard_ ||
+      header->buckets_per_shard != buckets_per_shard_) {
+    munmap(base_, size_);
+    close(fd_);
+    throw std::runtime_error("Shared tier " + name + " is incompatible");
+  }
+  return true;
+}
+
+SharedTier::~SharedTier() {
+  munmap(base_, size_);
+  close(fd_);
+}
+
+int SharedTier::Unlink(const std::string& name) {
+  return shm_unlink(name.c_str());
+}
+
+void SharedTier::OpenFile(const SharedFileKey& file, uint64_t ctime_ns) {
+  const FileTableLock lock(*this);
+  FileEntry& entry = FileEntryOf(file);
+  if (lock.Locked() && SameFile(entry.file, file) && entry.ctime_ns == ctime_ns) {
+    return;
+  }
+
+  // Modified around the tier, or not seen since its entry was taken. The
+  // blocks are dropped under the table lock, so that no open finds the new
+  // change time recorded while stale blocks remain.
+  if (lock.Locked()) {
+    entry = {file, ctime_ns};
+  }
+  EraseFrom(file, 0);
+}
+
+void SharedTier::UpdateFile(const SharedFileKey& file, uint64_t ctime_ns) {
+  const FileTableLock lock(*this);
+  if (lock.Locked()) {
+    FileEntryOf(file) = {file, ctime_ns};
+  }
+}
+
+bool SharedTier::Get(const SharedFileKey& file, uint64_t block_num, AlignedVec& data) {
+  const uint64_t hash = Hash(file, block_num);
+  const size_t shard = hash % KShards;
+  const ShardLock lock(*this, shard);
+  if (!lock.Locked()) {
+    return false;
+  }
+
+  const int32_t slot = Find(shard, (hash / KShards) % buckets_per_shard_, file, block_num);
+  if (slot == -1) {
+    ++ShardAt(shard).misses;
+    return false;
+  }
+  ++ShardAt(shard).hits;
+  const char* frame = FrameAt(shard, slot);
+  data.assign(frame, frame + block_size_);
+  return true;
+}
+
+bool SharedTier::Read(
+    const SharedFileKey& file,
+    uint64_t block_num,
+    size_t offset,
+    char* buf,
+    size_t size
+) {
+  const uint64_t hash = Hash(file, block_num);
+  const size_t shard = hash % KShards;
+  const ShardLock lock(*this, shard);
+  if (!lock.Locked()) {
+    return false;
+  }
+
+  const int32_t slot = Find(shard, (hash / KShards) % buckets_per_shard_, file, block_num);
+  if (slot == -1) {
+    ++ShardAt(shard).misses;
+    return false;
+  }
+  ++ShardAt(shard).hits;
+  std::memcpy(buf, FrameAt(shard, slot) + offset, size);
+  return true;
+}
+
+uint64_t SharedTier::FillToken(const SharedFileKey& file, uint64_t block_num) {
+  const size_t shard = Hash(file, block_num) % KShards;
+  const ShardLock lock(*this, shard);
+  return lock.Locked() ? ShardAt(shard).write_seq : UINT64_MAX;
+}
+
+void SharedTier::Fill(
+    const SharedFileKey& file,
+    uint64_t block_num,
+    const char* data,
+    uint64_t token
+) {
+  const uint64_t hash = Hash(file, block_num);
+  const size_t shard = hash % KShards;
+  const size_t bucket = (hash / KShards) % buckets_per_shard_;
+  const ShardLock lock(*this, shard);
+  if (!lock.Locked() || ShardAt(shard).write_seq != token ||
+      Find(shard, bucket, file, block_num) != -1) {
+    return;
+  }
+  Insert(shard, bucket, file, block_num, data);
+  ++ShardAt(shard).fills;
+}
+
+void SharedTier::Publish(const SharedFileKey& file, uint64_t block_num, const char* data) {
+  const uint64_t hash = Hash(file, block_num);
+  const size_t shard = hash % KShards;
+  const ShardLock lock(*this, shard);
+  if (!lock.Locked()) {
+    return;
+  }
+  ++ShardAt(shard).write_seq;
+  Insert(shard, (hash / KShards) % buckets_per_shard_, file, block_num, data);
+}
+
+void SharedTier::Erase(const SharedFileKey& file, uint64_t block_num) {
+  const uint64_t hash = Hash(file, block_num);
+  const size_t shard = hash % KShards;
+  const ShardLock lock(*this, shard);
+  if (!lock.Locked()) {
+    return;
+  }
+  ++ShardAt(shard).write_seq;
+  const int32_t slot = Find(shard, (hash / KShards) % buckets_per_shard_, file, block_num);
+  if (slot != -1) {
+    Remove(shard, slot);
+  }
+}
+
+void SharedTier::EraseFrom(const SharedFileKey& file, uint64_t first_block) {
+  for (size_t shard = 0; shard < KShards; ++shard) {
+    const ShardLock lock(*this, shard);
+    if (!lock.Locked()) {
+      continue;
+    }
+    ++ShardAt(shard).write_seq;
+    for (size_t slot = 0; slot < slots_per_shard_; ++slot) {
+      const Slot& entry = SlotAt(shard, slot);
+      if (entry.state.load(std::memory_order_relaxed) == Valid && SameFile(entry.file, file) &&
+          entry.block_num >= first_block) {
+        Remove(shard, static_cast<int32_t>(slot));
+      }
+    }
+  }
+}
+
+SharedTier::Stats SharedTier::GetStats() {
+  Stats stats;
+  for (size_t shard = 0; shard < KShards; ++shard) {
+    const ShardLock lock(*this, shard);
+    if (!lock.Locked()) {
+      continue;
+    }
+    const Shard& entry = ShardAt(shard);
+    stats.entries += entry.entries;
+    stats.hits += entry.hits;
+    stats.misses += entry.misses;
+    stats.fills += entry.fills;
+    stats.evictions += entry.evictions;
+    stats.recoveries += entry.recoveries;
+  }
+  return stats;
+}
+
+uint64_t SharedTier::Hash(const SharedFileKey& file, uint64_t block_num) {
+  const uint64_t key[] = {file.dev, file.ino, block_num};
+  return HashFrame(reinterpret_cast<const char*>(key), sizeof(key));
+}
+
+SharedTier::Header& SharedTier::HeaderOf() {
+  return *reinterpret_cast<Header*>(base_);
+}
+
+SharedTier::Shard& SharedTier::ShardAt(size_t shard) {
+  return *reinterpret_cast<Shard*>(base_ + shards_offset_ + shard * AlignUp(sizeof(Shard), 64));
+}
+
+SharedTier::FileEntry* SharedTier::FileTable() {
+  return reinterpret_cast<FileEntry*>(base_ + files_offset_);
+}
+
+SharedTier::FileEntry& SharedTier::FileEntryOf(const SharedFileKey& file) {
+  const uint64_t key[] = {file.dev, file.ino};
+  return FileTable()[HashFrame(reinterpret_cast<const char*>(key), sizeof(key)) % KFileEntries];
+}
+
+SharedTier::Slot& SharedTier::SlotAt(size_t shard, size_t slot) {
+  return reinterpret_cast<Slot*>(base_ + slots_offset_)[shard * slots_per_shard_ + slot];
+}
+
+int32_t* SharedTier::Buckets(size_t shard) {
+  return reinterpret_cast<int32_t*>(base_ + buckets_offset_) + shard * buckets_per_shard_;
+}
+
+char* SharedTier::FrameAt(size_t shard, size_t slot) {
+  return base_ + frames_offset_ + (shard * slots_per_shard_ + slot) * block_size_;
+}
+
+int32_t SharedTier::Find(
+    size_t shard,
+    size_t bucket,
+    const SharedFileKey& file,
+    uint64_t block_num
+) {
+  for (int32_t slot = Buckets(shard)[bucket]; slot != -1; slot = SlotAt(shard, slot).next) {
+    const Slot& entry = SlotAt(shard, slot);
+    if (entry.state.load(std::memory_order_relaxed) == Valid && entry.block_num == block_num &&
+        SameFile(entry.file, file)) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+void SharedTier::Insert(
+    size_t shard,
+    size_t bucket,
+    const SharedFileKey& file,
+    uint64_t block_num,
+    const char* data
+) {
+  Shard& header = ShardAt(shard);
+  int32_t slot = Find(shard, bucket, file, block_num);
+  const bool relink = slot == -1;
+  if (relink) {
+    slot = static_cast<int32_t>(header.hand);
+    header.hand = (header.hand + 1) % slots_per_shard_;
+    if (SlotAt(shard, slot).state.load(std::memory_order_relaxed) == Valid) {
+      Remove(shard, slot);
+      ++header.evictions;
+    }
+    ++header.entries;
+  }
+
+  // Mark the slot before touching it, so that recovery drops it if this
+  // process dies halfway; the acquire keeps the writes below after the mark
+  Slot& entry = SlotAt(shard, slot);
+  entry.state.exchange(Writing, std::memory_order_acq_rel);
+  entry.file = file;
+  entry.block_num = block_num;
+  std::memcpy(FrameAt(shard, slot), data, block_size_);
+  if (relink) {
+    entry.next = Buckets(shard)[bucket];
+    Buckets(shard)[bucket] = slot;
+  }
+  entry.state.store(Valid, std::memory_order_release);
+}
+
+void SharedTier::Remove(size_t shard, int32_t slot) {
+  Slot& entry = SlotAt(shard, slot);
+  int32_t* link = &Buckets(shard)[BucketOf(entry)];
+  while (*link != -1 && *link != slot) {
+    link = &SlotAt(shard, *link).next;
+  }
+  if (*link == slot) {
+    *link = entry.next;
+  }
+  entry.next = -1;
+  entry.state.store(Free, std::memory_order_release);
+  --ShardAt(shard).entries;
+}
+
+void SharedTier::Recover(size_t shard) {
+  std::fill_n(Buckets(shard), buckets_per_shard_, -1);
+  size_t entries = 0;
+  for (size_t slot = 0; slot < slots_per_shard_; ++slot) {
+    Slot& entry = SlotAt(shard, slot);
+    entry.next = -1;
+    if (entry.state.load(std::memory_order_relaxed) != Valid) {
+      entry.state.store(Free, std::memory_order_relaxed);
+      continue;
+    }
+    int32_t& head = Buckets(shard)[BucketOf(entry)];
+    entry.next = head;
+    head = static_cast<int32_t>(slot);
+    ++entries;
+  }
+
+  Shard& header = ShardAt(shard);
+  header.entries = entries;
+  header.hand %= slots_per_shard_;
+  // Fills started before the crash may carry stale data
+  ++header.write_seq;
+}
+
+size_t SharedTier::BucketOf(const Slot& slot) const {
+  return (Hash(slot.file, slot.block_num) / KShards) % buckets_per_shard_;
+}
+
+}  // namespace lab2
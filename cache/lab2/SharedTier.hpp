@@ -0,0 +1,212 @@
+#pragma once
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "./Block.hpp"
+
+namespace lab2 {
+
+// Identity of a file, the same in every process.
+struct SharedFileKey {
+  uint64_t dev = 0;
+  uint64_t ino = 0;
+};
+
+// Pool of clean blocks in a POSIX shared memory object, shared by every
+// process attached to it. The frames, the block index and the FIFO eviction
+// state all live in the segment, split into shards that each have their own
+// process-shared robust mutex. Frames are only copied in and out under the
+// shard lock, so a process that dies while holding it leaves at most one
+// half-written frame; the next process to take the lock drops it and
+// rebuilds the shard's index.
+//
+// A file table in the segment records the change time of every file as of
+// the last write made through the tier, so that blocks outlive writebacks
+// while a file modified or replaced around the tier loses them on its next
+// open.
+class SharedTier {
+public:
+  static constexpr size_t KShards = 16;
+  // Files the table tracks. A file whose entry was taken by another one is
+  // treated as modified on its next open.
+  static constexpr size_t KFileEntries = 4096;
+  // Longest wait for another process to finish creating the segment, after
+  // which it is taken as abandoned and created again.
+  static constexpr std::chrono::seconds KAttachTimeout{5};
+
+  // Counters of the whole segment, over all attached processes.
+  struct Stats {
+    size_t entries = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t fills = 0;
+    size_t evictions = 0;
+    size_t recoveries = 0;  // Shards repaired after their lock holder died
+  };
+
+  // Attaches to the segment called name (as for shm_open), creating it with
+  // room for capacity blocks of block_size bytes if it doesn't exist. Throws
+  // std::runtime_error if it cannot be created, or exists with another
+  // geometry.
+  SharedTier(const std::string& name, size_t capacity, size_t block_size = KBlockSize);
+
+  // Detaches from the segment, which persists until Unlink.
+  ~SharedTier();
+
+  SharedTier(const SharedTier&) = delete;
+  SharedTier& operator=(const SharedTier&) = delete;
+  SharedTier(SharedTier&&) = delete;
+  SharedTier& operator=(SharedTier&&) = delete;
+
+  // Removes the segment once every process detached from it.
+  static int Unlink(const std::string& name);
+
+  // Records an open of the file, whose change time is ctime_ns. Drops the
+  // file's blocks unless the change time is the one last recorded for it.
+  void OpenFile(const SharedFileKey& file, uint64_t ctime_ns);
+
+  // Records the change time of the file after a write through the tier.
+  void UpdateFile(const SharedFileKey& file, uint64_t ctime_ns);
+
+  // Copies the block into data. Returns false if it is not stored.
+  bool Get(const SharedFileKey& file, uint64_t block_num, AlignedVec& data);
+
+  // Copies size bytes of the block from offset into buf, straight from the
+  // shared frame. Returns false if it is not stored.
+  bool Read(const SharedFileKey& file, uint64_t block_num, size_t offset, char* buf, size_t size);
+
+  // Returns a token to take before reading a block from disk and pass to
+  // Fill, which drops the block if the shard was written in between.
+  uint64_t FillToken(const SharedFileKey& file, uint64_t block_num);
+
+  // Stores a block read from disk, unless it is already stored or the
+  // shard was written since token was taken (the read may be stale).
+  void Fill(const SharedFileKey& file, uint64_t block_num, const char* data, uint64_t token);
+
+  // Stores a block just written to disk, replacing any older copy.
+  void Publish(const SharedFileKey& file, uint64_t block_num, const char* data);
+
+  // Drops the block, e.g. because it is being rewritten.
+  void Erase(const SharedFileKey& file, uint64_t block_num);
+
+  // Drops the file's blocks from first_block on, after a truncate.
+  void EraseFrom(const SharedFileKey& file, uint64_t first_block);
+
+  Stats GetStats();
+
+private:
+  enum SlotState : uint32_t {
+    Free,
+    Writing,  // Being filled, dropped by recovery
+    Valid,
+  };
+
+  struct Header;
+  struct Shard;
+
+  struct FileEntry {
+    SharedFileKey file;  // Zero while unused
+    uint64_t ctime_ns;
+  };
+
+  struct Slot {
+    SharedFileKey file;
+    uint64_t block_num;
+    std::atomic<uint32_t> state;
+    int32_t next;  // Next slot of the bucket chain, -1 ends it
+  };
+
+  // Holds the file table lock, clearing the table if its previous holder
+  // died, as the entry it was writing may be torn.
+  class FileTableLock {
+  public:
+    explicit FileTableLock(SharedTier& tier);
+    ~FileTableLock();
+
+    FileTableLock(const FileTableLock&) = delete;
+    FileTableLock& operator=(const FileTableLock&) = delete;
+
+    bool Locked() const {
+      return locked_;
+    }
+
+  private:
+    Header& header_;
+    bool locked_ = false;
+  };
+
+  // Holds a shard lock, repairing the shard if its previous holder died.
+  class ShardLock {
+  public:
+    ShardLock(SharedTier& tier, size_t shard);
+    ~ShardLock();
+
+    ShardLock(const ShardLock&) = delete;
+    ShardLock& operator=(const ShardLock&) = delete;
+
+    bool Locked() const {
+      return locked_;
+    }
+
+  private:
+    Shard& shard_;
+    bool locked_ = false;
+  };
+
+  // Hash of a block, picking its shard and its bucket within the shard.
+  // Creates or attaches to the segment and maps it. Returns false if another
+  // process created it but it stayed uninitialized for KAttachTimeout.
+  bool Attach(const std::string& name);
+
+  static uint64_t Hash(const SharedFileKey& file, uint64_t block_num);
+  Header& HeaderOf();
+  Shard& ShardAt(size_t shard);
+  FileEntry* FileTable();
+  // Entry of the table the file maps to, possibly holding another file.
+  FileEntry& FileEntryOf(const SharedFileKey& file);
+  Slot& SlotAt(size_t shard, size_t slot);
+  int32_t* Buckets(size_t shard);
+  char* FrameAt(size_t shard, size_t slot);
+
+  // Returns the valid slot holding the block, or -1.
+  int32_t Find(size_t shard, size_t bucket, const SharedFileKey& file, uint64_t block_num);
+
+  // Stores the block in its existing slot or in the next FIFO victim.
+  void Insert(
+      size_t shard,
+      size_t bucket,
+      const SharedFileKey& file,
+      uint64_t block_num,
+      const char* data
+  );
+
+  // Removes a slot from its bucket chain and frees it.
+  void Remove(size_t shard, int32_t slot);
+
+  // Drops half-written slots and rebuilds the shard's bucket chains.
+  void Recover(size_t shard);
+
+  // Bucket of the shard's index that holds the slot.
+  size_t BucketOf(const Slot& slot) const;
+
+  int fd_ = -1;
+  size_t block_size_;
+  char* base_ = nullptr;
+  size_t size_ = 0;
+  size_t slots_per_shard_ = 0;
+  size_t buckets_per_shard_ = 0;
+  size_t shards_offset_ = 0;
+  size_t files_offset_ = 0;
+  size_t slots_offset_ = 0;
+  size_t buckets_offset_ = 0;
+  size_t frames_offset_ = 0;
+};
+
+}  // namespace lab2
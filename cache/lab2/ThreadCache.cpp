@@ -0,0 +1,68 @@
+#include "./ThreadCache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace lab2 {
+
+namespace {
+
+size_t SlotOf(uint64_t block_id) {
+  // Mix the fd into the block number so that files don't collide on the same slots
+  return ((block_id >> KFdOffset) * 0x9E3779B1U + block_id) % ThreadCache::KEntries;
+}
+
+}  // namespace
+
+ThreadCache& ThreadCache::Local() {
+  // Heap-allocated so that threads which never read don't pay for the entries
+  thread_local std::unique_ptr<ThreadCache> local = std::make_unique<ThreadCache>();
+  return *local;
+}
+
+ThreadCache::Entry* ThreadCache::Find(uint64_t cache_id, uint64_t block_id) {
+  Entry& entry = entries_[SlotOf(block_id)];
+  if (entry.cache_id != cache_id || entry.block_id != block_id) {
+    return nullptr;
+  }
+  return &entry;
+}
+
+void ThreadCache::Put(
+    uint64_t cache_id,
+    uint64_t block_id,
+    uint64_t version,
+    const char* data,
+    size_t size
+) {
+  Entry& entry = entries_[SlotOf(block_id)];
+  entry.cache_id = cache_id;
+  entry.block_id = block_id;
+  entry.version = version;
+  entry.size = size;
+  if (entry.data.size() < size) {
+    entry.data.resize(size);
+  }
+  std::memcpy(entry.data.data(), data, size);
+}
+
+FileHandle* ThreadCache::FindFile(uint64_t cache_id, int fd) {
+  FileRef& ref = files_[static_cast<size_t>(fd) % KFiles];
+  if (ref.cache_id != cache_id || ref.fd != fd) {
+    return nullptr;
+  }
+  return ref.file.get();
+}
+
+void ThreadCache::PutFile(uint64_t cache_id, int fd, const std::shared_ptr<FileHandle>& file) {
+  FileRef& ref = files_[static_cast<size_t>(fd) % KFiles];
+  if (ref.cache_id == cache_id && ref.fd == fd) {
+    return;
+  }
+  ref.cache_id = cache_id;
+  ref.fd = fd;
+  ref.file = file;
+}
+
+}  // namespace lab2
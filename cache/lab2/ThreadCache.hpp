@@ -0,0 +1,60 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "./Block.hpp"
+
+namespace lab2 {
+
+struct FileHandle;
+
+// Small per-thread front cache of recently read blocks. Entries are private
+// copies of cached blocks, tagged with the version the block had when it was
+// copied; the owning cache bumps that version whenever the block changes or
+// leaves it, so a stale entry is detected without taking the cache lock.
+class ThreadCache {
+public:
+  static constexpr size_t KEntries = 32;
+  static constexpr size_t KFiles = 8;
+
+  struct Entry {
+    uint64_t cache_id = 0;  // 0 marks an empty slot
+    uint64_t block_id = 0;
+    uint64_t version = 0;
+    size_t size = 0;
+    std::vector<char> data;  // Grown to the block size by the first Put
+  };
+
+  // Returns the calling thread's front cache. It is released when the thread exits.
+  static ThreadCache& Local();
+
+  // Returns the entry for the block, or nullptr if it is not cached.
+  Entry* Find(uint64_t cache_id, uint64_t block_id);
+
+  // Stores a copy of the block, replacing whatever shared its slot.
+  void Put(uint64_t cache_id, uint64_t block_id, uint64_t version, const char* data, size_t size);
+
+  // Returns the handle remembered for a user fd, or nullptr.
+  FileHandle* FindFile(uint64_t cache_id, int fd);
+
+  // Remembers the handle of a user fd so that later hits skip the open file table.
+  void PutFile(uint64_t cache_id, int fd, const std::shared_ptr<FileHandle>& file);
+
+private:
+  struct FileRef {
+    uint64_t cache_id = 0;
+    int fd = -1;
+    std::shared_ptr<FileHandle> file;
+  };
+
+  std::array<Entry, KEntries> entries_;
+  std::array<FileRef, KFiles> files_;
+};
+
+}  // namespace lab2
@@ -0,0 +1,253 @@
+#include "./Trace.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lab2 {
+
+namespace {
+
+// Fields are relaxed atomics so that a reader racing with the writer sees
+// stale or torn events rather than undefined behaviour; torn ones are
+// dropped by checking the head again after the copy.
+struct TraceSlot {
+  std::atomic<uint64_t> start{0};
+  std::atomic<uint64_t> duration{0};
+  std::atomic<uint64_t> arg{0};
+  std::atomic<uint64_t> tag{0};  // Recording thread index << 8 | event
+};
+
+// Ring of events written by a single thread at a time.
+struct TraceRing {
+  uint32_t thread = 0;  // Index of the owning thread
+  std::atomic<uint64_t> head{0};  // Events written so far
+  std::atomic<uint64_t> tail{0};  // Events before it were cleared
+  std::atomic<bool> in_use{true};
+  std::array<TraceSlot, KTraceBufferEvents> slots;
+};
+
+struct TraceRegistry {
+  std::mutex mutex;
+  // Rings of exited threads are handed to new threads, bounding the memory
+  // of programs that churn threads. Their events are kept until overwritten.
+  std::vector<std::unique_ptr<TraceRing>> rings;
+  uint32_t next_thread = 1;
+  // Reference point converting ticks to wall time.
+  uint64_t base_ticks = TraceNow();
+  std::chrono::steady_clock::time_point base_time = std::chrono::steady_clock::now();
+};
+
+// Leaked, as threads may still record while static objects are destroyed.
+TraceRegistry& Registry() {
+  static auto* registry = new TraceRegistry();
+  return *registry;
+}
+
+// Sets the reference point when the library is loaded, before any event.
+[[maybe_unused]] const TraceRegistry& registry_at_load = Registry();
+
+TraceRing* AcquireRing() {
+  TraceRegistry& registry = Registry();
+  const std::lock_guard<std::mutex> lock(registry.mutex);
+
+  TraceRing* ring = nullptr;
+  for (const auto& entry : registry.rings) {
+    if (!entry->in_use.load(std::memory_order_relaxed)) {
+      ring = entry.get();
+      break;
+    }
+  }
+  if (ring == nullptr) {
+    registry.rings.push_back(std::make_unique<TraceRing>());
+    ring = registry.rings.back().get();
+  }
+
+  ring->thread = registry.next_thread++;
+  ring->in_use.store(true, std::memory_order_relaxed);
+  return ring;
+}
+
+// Owns the calling thread's ring and releases it when the thread exits.
+class RingOwner {
+public:
+  RingOwner()
+      : ring_(AcquireRing()) {
+  }
+
+  ~RingOwner() {
+    const std::lock_guard<std::mutex> lock(Registry().mutex);
+    ring_->in_use.store(false, std::memory_order_relaxed);
+  }
+
+  RingOwner(const RingOwner&) = delete;
+  RingOwner& operator=(const RingOwner&) = delete;
+
+  TraceRing& Ring() {
+    return *ring_;
+  }
+
+private:
+  TraceRing* ring_;
+};
+
+const char* EventName(TraceEvent event) {
+  switch (event) {
+    case TraceEvent::LookupHit:
+      return "hit";
+    case TraceEvent::LookupMiss:
+      return "miss";
+    case TraceEvent::Fetch:
+      return "fetch";
+    case TraceEvent::Evict:
+      return "evict";
+    case TraceEvent::Writeback:
+      return "writeback";
+    case TraceEvent::Sync:
+      return "sync";
+    case TraceEvent::LockWait:
+      return "lock_wait";
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+uint64_t TraceNow() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()
+  )
+      .count();
+#endif
+}
+
+void RecordTrace(TraceEvent event, uint64_t start, uint64_t duration, uint64_t arg) {
+  thread_local RingOwner owner;
+  TraceRing& ring = owner.Ring();
+
+  const uint64_t head = ring.head.load(std::memory_order_relaxed);
+  TraceSlot& slot = ring.slots[head % KTraceBufferEvents];
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(duration, std::memory_order_relaxed);
+  slot.arg.store(arg, std::memory_order_relaxed);
+  slot.tag.store(
+      static_cast<uint64_t>(ring.thread) << 8 | static_cast<uint8_t>(event),
+      std::memory_order_relaxed
+  );
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<TraceRecord> SnapshotTrace() {
+  TraceRegistry& registry = Registry();
+  const std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::vector<TraceRecord> records;
+  for (const auto& ring : registry.rings) {
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    const uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t first = head > KTraceBufferEvents ? head - KTraceBufferEvents : 0;
+    first = std::max(first, tail);
+
+    const size_t begin = records.size();
+    for (uint64_t index = first; index < head; ++index) {
+      const TraceSlot& slot = ring->slots[index % KTraceBufferEvents];
+      const uint64_t tag = slot.tag.load(std::memory_order_relaxed);
+      records.push_back(
+          {static_cast<uint32_t>(tag >> 8),
+           static_cast<TraceEvent>(tag & 0xFF),
+           slot.start.load(std::memory_order_relaxed),
+           slot.duration.load(std::memory_order_relaxed),
+           slot.arg.load(std::memory_order_relaxed)}
+      );
+    }
+
+    // Drop the events the writer may have overwritten during the copy,
+    // including the slot it may be writing right now. The read-modify-write
+    // orders the head read after the copy.
+    const uint64_t new_head = ring->head.fetch_add(0, std::memory_order_acq_rel);
+    if (new_head >= KTraceBufferEvents && new_head - KTraceBufferEvents + 1 > first) {
+      const uint64_t overwritten = std::min(head, new_head - KTraceBufferEvents + 1) - first;
+      records.erase(records.begin() + begin, records.begin() + begin + overwritten);
+    }
+  }
+  return records;
+}
+
+void ClearTrace() {
+  TraceRegistry& registry = Registry();
+  const std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto& ring : registry.rings) {
+    ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+}
+
+ssize_t WriteChromeTrace(const std::string& path) {
+  const std::vector<TraceRecord> records = SnapshotTrace();
+
+  // Calibrate the timestamp counter against the clock, over at least 10 ms
+  TraceRegistry& registry = Registry();
+  const auto min_interval = std::chrono::milliseconds(10);
+  while (std::chrono::steady_clock::now() - registry.base_time < min_interval) {
+    std::this_thread::sleep_for(min_interval);
+  }
+  const uint64_t ticks = TraceNow() - registry.base_ticks;
+  const double elapsed_us = std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - registry.base_time
+  )
+                                .count();
+  const double ticks_per_us = static_cast<double>(ticks) / elapsed_us;
+
+  FILE* file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return -1;
+  }
+
+  std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (size_t i = 0; i < records.size(); ++i) {
+    const TraceRecord& record = records[i];
+    const double ts = static_cast<double>(record.start - registry.base_ticks) / ticks_per_us;
+    std::fprintf(
+        file,
+        "%s\n{\"name\":\"%s\",\"cat\":\"lab2\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,",
+        i == 0 ? "" : ",",
+        EventName(record.event),
+        record.thread,
+        ts
+    );
+    if (record.duration == 0) {
+      std::fprintf(file, "\"ph\":\"i\",\"s\":\"t\",");
+    } else {
+      std::fprintf(
+          file, "\"ph\":\"X\",\"dur\":%.3f,", static_cast<double>(record.duration) / ticks_per_us
+      );
+    }
+    std::fprintf(
+        file, "\"args\":{\"arg\":%llu}}", static_cast<unsigned long long>(record.arg)
+    );
+  }
+  std::fprintf(file, "\n]}\n");
+
+  if (std::fclose(file) != 0) {
+    return -1;
+  }
+  return static_cast<ssize_t>(records.size());
+}
+
+}  // namespace lab2
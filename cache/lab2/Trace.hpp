@@ -0,0 +1,92 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lab2 {
+
+// Points of the cache recorded by the trace points.
+enum class TraceEvent : uint8_t {
+  LookupHit,
+  LookupMiss,
+  Fetch,      // Loading a missed block from the lower tiers or disk
+  Evict,      // Evicting a block, including its writeback
+  Writeback,  // Writing a block home or to the journal
+  Sync,
+  LockWait,  // Waiting for the cache lock
+};
+
+// An event read back from the trace buffers. Spans have a duration, instants don't.
+struct TraceRecord {
+  uint32_t thread;    // Index of the recording thread, from 1
+  TraceEvent event;
+  uint64_t start;     // Timestamp counter ticks
+  uint64_t duration;  // Ticks
+  uint64_t arg;       // Block id, or user fd for file-level events
+};
+
+// Events kept per thread. Once a thread's buffer is full, its oldest events
+// are overwritten.
+static constexpr size_t KTraceBufferEvents = 4096;
+
+// Reads the timestamp counter (the TSC on x86, a monotonic clock elsewhere).
+uint64_t TraceNow();
+
+// Appends an event to the calling thread's buffer. Lock-free: each thread
+// writes only its own ring, and readers detect events overwritten under them.
+void RecordTrace(TraceEvent event, uint64_t start, uint64_t duration, uint64_t arg);
+
+// Copies out the events still held in the buffers, oldest first per thread.
+std::vector<TraceRecord> SnapshotTrace();
+
+// Drops the events recorded so far.
+void ClearTrace();
+
+// Writes the buffered events to path in the Chrome trace event format, which
+// chrome://tracing and Perfetto open. Returns the number of events written,
+// or -1 on error.
+ssize_t WriteChromeTrace(const std::string& path);
+
+// Records a span from construction to destruction.
+class TraceScope {
+public:
+  TraceScope(TraceEvent event, uint64_t arg)
+      : event_(event)
+      , arg_(arg)
+      , start_(TraceNow()) {
+  }
+
+  ~TraceScope() {
+    RecordTrace(event_, start_, TraceNow() - start_, arg_);
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  TraceEvent event_;
+  uint64_t arg_;
+  uint64_t start_;
+};
+
+}  // namespace lab2
+
+// Trace points, compiled in only when LAB2_TRACE is defined (CMake option
+// lab2_TRACE) so that they cost nothing otherwise.
+#ifdef LAB2_TRACE
+#define LAB2_TRACE_CONCAT_INNER(a, b) a##b
+#define LAB2_TRACE_CONCAT(a, b) LAB2_TRACE_CONCAT_INNER(a, b)
+#define LAB2_TRACE_SCOPE(event, arg)                                  \
+  const ::lab2::TraceScope LAB2_TRACE_CONCAT(trace_scope_, __LINE__)( \
+      ::lab2::TraceEvent::event, static_cast<uint64_t>(arg)           \
+  )
+#define LAB2_TRACE_INSTANT(event, arg) \
+  ::lab2::RecordTrace(::lab2::TraceEvent::event, ::lab2::TraceNow(), 0, static_cast<uint64_t>(arg))
+#else
+#define LAB2_TRACE_SCOPE(event, arg) static_cast<void>(0)
+#define LAB2_TRACE_INSTANT(event, arg) static_cast<void>(0)
+#endif
@@ -0,0 +1,277 @@
+#include "./VictimCache.hpp"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace lab2 {
+
+VictimCache::VictimCache(const std::string& path, size_t capacity, size_t block_size)
+    : block_size_(block_size)
+    , slots_(capacity) {
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  if (fd_ == -1 && errno == EINVAL) {
+    // The file system doesn't support O_DIRECT (e.g. tmpfs)
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd_ == -1) {
+    throw std::runtime_error("Failed to open victim cache file " + path);
+  }
+
+  const auto file_size = static_cast<off_t>(capacity * block_size_);
+  if (posix_fallocate(fd_, 0, file_size) != 0 && ftruncate(fd_, file_size) != 0) {
+    close(fd_);
+    throw std::runtime_error("Failed to preallocate victim cache file " + path);
+  }
+
+  free_slots_.reserve(capacity);
+  for (size_t slot = capacity; slot > 0; --slot) {
+    free_slots_.push_back(slot - 1);
+  }
+
+  writer_ = std::thread(&VictimCache::WriterLoop, this);
+}
+
+VictimCache::~VictimCache() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_writer_.notify_one();
+  writer_.join();
+  close(fd_);
+}
+
+void VictimCache::Put(uint64_t block_id, const char* data, size_t size) {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = index_.find(block_id);
+  if (it != index_.end()) {
+    // Still valid, as rewrites invalidate it
+    slots_[it->second].referenced = true;
+    return;
+  }
+
+  if (queue_.size() >= KMaxPendingBlocks) {
+    ++stats_.dropped;
+    return;
+  }
+  const ssize_t slot = AllocateSlot();
+  if (slot == -1) {
+    ++stats_.dropped;
+    return;
+  }
+
+  slots_[slot] = {block_id, size, SlotState::Pending, false};
+  AlignedVec copy(block_size_, 0);
+  std::memcpy(copy.data(), data, size);
+  pending_[slot] = std::move(copy);
+  queue_.push_back(slot);
+  index_[block_id] = slot;
+  ++stats_.entries;
+  ++stats_.stored;
+
+  if (queue_.size() >= KWriteBatchBlocks) {
+    wake_writer_.notify_one();
+  }
+}
+
+bool VictimCache::Get(uint64_t block_id, AlignedVec& data) {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = index_.find(block_id);
+  if (it == index_.end()) {
+    return false;
+  }
+
+  const size_t slot = it->second;
+  Slot& entry = slots_[slot];
+  if (entry.state == SlotState::Valid) {
+    data.assign(block_size_, 0);
+    const ssize_t bytes_read =
+        pread(fd_, data.data(), block_size_, static_cast<off_t>(slot * block_size_));
+    if (bytes_read != static_cast<ssize_t>(block_size_)) {
+      InvalidateLocked(it);
+      return false;
+    }
+    data.resize(entry.size);
+  } else {
+    const AlignedVec& queued = pending_[slot];
+    data.assign(queued.begin(), queued.begin() + static_cast<ssize_t>(entry.size));
+  }
+
+  entry.referenced = true;
+  ++stats_.hits;
+  return true;
+}
+
+void VictimCache::Invalidate(uint64_t block_id) {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = index_.find(block_id);
+  if (it != index_.end()) {
+    InvalidateLocked(it);
+  }
+}
+
+void VictimCache::InvalidateFile(int fd) {
+  const std::lock_guard<std::mutex> lock(mutex_);
+
+  for (auto it = index_.begin(); it != index_.end();) {
+    auto next = std::next(it);
+    if ((it->first >> KFdOffset) == static_cast<uint64_t>(fd)) {
+      InvalidateLocked(it);
+    }
+    it = next;
+  }
+}
+
+void VictimCache::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  ++flush_waiters_;
+  wake_writer_.notify_one();
+  batch_done_.wait(lock, [this] {
+    return queue_.empty() && !writing_;
+  });
+  --flush_waiters_;
+}
+
+VictimCache::Stats VictimCache::GetStats() {
+  const std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+// Private Methods
+
+ssize_t VictimCache::AllocateSlot() {
+  if (!free_slots_.empty()) {
+    const size_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return static_cast<ssize_t>(slot);
+  }
+
+  // CLOCK: replace the first valid slot not referenced since the hand last passed
+  for (size_t step = 0; step < 2 * slots_.size(); ++step) {
+    const size_t slot = clock_hand_;
+    clock_hand_ = (clock_hand_ + 1) % slots_.size();
+
+    Slot& entry = slots_[slot];
+    if (entry.state != SlotState::Valid) {
+      continue;
+    }
+    if (entry.referenced) {
+      entry.referenced = false;
+      continue;
+    }
+
+    index_.erase(entry.block_id);
+    --stats_.entries;
+    entry = Slot{};
+    return static_cast<ssize_t>(slot);
+  }
+
+  return -1;
+}
+
+void VictimCache::FreeSlot(size_t slot) {
+  slots_[slot] = Slot{};
+  free_slots_.push_back(slot);
+}
+
+void VictimCache::InvalidateLocked(std::unordered_map<uint64_t, size_t>::iterator it) {
+  const size_t slot = it->second;
+  index_.erase(it);
+  --stats_.entries;
+
+  switch (slots_[slot].state) {
+    case SlotState::Pending:
+      queue_.erase(std::find(queue_.begin(), queue_.end(), slot));
+      pending_.erase(slot);
+      FreeSlot(slot);
+      break;
+    case SlotState::Writing:
+      // The writer still uses the data, it frees the slot when done
+      slots_[slot].state = SlotState::Zombie;
+      break;
+    default:
+      FreeSlot(slot);
+      break;
+  }
+}
+
+void VictimCache::WriterLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    wake_writer_.wait_for(lock, KWriteDelay, [this] {
+      return stop_ || (!queue_.empty() && flush_waiters_ > 0) ||
+             queue_.size() >= KWriteBatchBlocks;
+    });
+    if (queue_.empty()) {
+      if (stop_) {
+        return;
+      }
+      continue;
+    }
+
+    std::vector<size_t> batch;
+    batch.swap(queue_);
+    std::sort(batch.begin(), batch.end());
+    std::vector<iovec> buffers;
+    buffers.reserve(batch.size());
+    for (const size_t slot : batch) {
+      slots_[slot].state = SlotState::Writing;
+      buffers.push_back({pending_[slot].data(), block_size_});
+    }
+    writing_ = true;
+    lock.unlock();
+
+    // Write runs of adjacent slots with a single pwritev each
+    std::vector<bool> failed(batch.size(), false);
+    for (size_t begin = 0; begin < batch.size();) {
+      size_t end = begin + 1;
+      while (end < batch.size() && batch[end] == batch[end - 1] + 1 && end - begin < IOV_MAX) {
+        ++end;
+      }
+      const auto count = static_cast<int>(end - begin);
+      const ssize_t written = pwritev(
+          fd_, &buffers[begin], count, static_cast<off_t>(batch[begin] * block_size_)
+      );
+      if (written != static_cast<ssize_t>(count * block_size_)) {
+        std::fill(failed.begin() + begin, failed.begin() + end, true);
+      }
+      begin = end;
+    }
+
+    lock.lock();
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const size_t slot = batch[i];
+      pending_.erase(slot);
+      if (slots_[slot].state == SlotState::Zombie) {
+        FreeSlot(slot);
+      } else if (failed[i]) {
+        index_.erase(slots_[slot].block_id);
+        --stats_.entries;
+        FreeSlot(slot);
+      } else {
+        slots_[slot].state = SlotState::Valid;
+      }
+    }
+    ++stats_.batches;
+    writing_ = false;
+    batch_done_.notify_all();
+  }
+}
+
+}  // namespace lab2
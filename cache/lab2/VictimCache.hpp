@@ -0,0 +1,115 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "./Block.hpp"
+
+namespace lab2 {
+
+// Second-level cache of clean blocks kept in a preallocated local file,
+// typically on a faster device than the origin files. Blocks are stored in
+// fixed slots found through an in-memory index and replaced with the CLOCK
+// policy. Stores are queued and written by a background thread in batches;
+// until then lookups are served from the queued copy.
+class VictimCache {
+public:
+  // Blocks queued for the writer before it is woken up early.
+  static constexpr size_t KWriteBatchBlocks = 32;
+  // Queued blocks beyond which stores are dropped instead of queued.
+  static constexpr size_t KMaxPendingBlocks = 1024;
+  // Longest time a queued block waits for the writer.
+  static constexpr std::chrono::milliseconds KWriteDelay{5};
+
+  struct Stats {
+    size_t entries = 0;
+    size_t stored = 0;
+    size_t hits = 0;
+    size_t dropped = 0;  // Stores given up because of a full queue or no free slot
+    size_t batches = 0;  // Batches written by the background writer
+  };
+
+  // Creates (or truncates) the cache file at path with room for capacity
+  // blocks of block_size bytes. Throws std::runtime_error if the file cannot
+  // be created.
+  VictimCache(const std::string& path, size_t capacity, size_t block_size = KBlockSize);
+
+  ~VictimCache();
+
+  VictimCache(const VictimCache&) = delete;
+  VictimCache& operator=(const VictimCache&) = delete;
+  VictimCache(VictimCache&&) = delete;
+  VictimCache& operator=(VictimCache&&) = delete;
+
+  // Stores a clean block, unless the same block is already stored.
+  void Put(uint64_t block_id, const char* data, size_t size);
+
+  // Copies the block into data. Returns false if it is not stored.
+  bool Get(uint64_t block_id, AlignedVec& data);
+
+  // Drops the block, e.g. because its origin was rewritten.
+  void Invalidate(uint64_t block_id);
+
+  // Drops all blocks of a user fd.
+  void InvalidateFile(int fd);
+
+  // Waits until every queued block has been written to the file.
+  void Flush();
+
+  Stats GetStats();
+
+private:
+  enum class SlotState : uint8_t {
+    Free,
+    Pending,  // Queued for the writer, data in pending_
+    Writing,  // Being written by the writer, data in pending_
+    Valid,    // On disk
+    Zombie,   // Invalidated while being written, freed once the write is done
+  };
+
+  struct Slot {
+    uint64_t block_id = 0;
+    size_t size = 0;
+    SlotState state = SlotState::Free;
+    bool referenced = false;
+  };
+
+  // Picks a slot for a new block, replacing a valid one if needed. Returns -1
+  // if every slot is busy.
+  ssize_t AllocateSlot();
+
+  void FreeSlot(size_t slot);
+
+  void InvalidateLocked(std::unordered_map<uint64_t, size_t>::iterator it);
+
+  void WriterLoop();
+
+  int fd_ = -1;
+  size_t block_size_;
+  std::vector<Slot> slots_;
+  std::vector<size_t> free_slots_;
+  size_t clock_hand_ = 0;
+  std::unordered_map<uint64_t, size_t> index_;  // block_id to slot
+  std::unordered_map<size_t, AlignedVec> pending_;  // slot to data not yet on disk
+  std::vector<size_t> queue_;                       // Pending slots, in store order
+  Stats stats_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_writer_;
+  std::condition_variable batch_done_;
+  bool writing_ = false;
+  size_t flush_waiters_ = 0;
+  bool stop_ = false;
+  std::thread writer_;
+};
+
+}  // namespace lab2
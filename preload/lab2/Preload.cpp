@@ -0,0 +1,552 @@
+// LD_PRELOAD shim routing file I/O of unmodified programs through the lab2
+// cache. Files whose absolute path matches LAB2_PRELOAD_PATTERN (a prefix, or
+// an fnmatch glob if it has wildcards) are opened both by libc, which keeps
+// the application's fd number reserved and valid for calls the shim doesn't
+// cover (mmap, readv, fcntl...), and by lab2_open; the covered calls on that
+// fd then go to the cache. Everything else goes to the next definition found
+// with dlsym(RTLD_NEXT). Files opened with O_APPEND, O_PATH or O_DIRECTORY,
+// and files the cache cannot open, are left alone. Calls made from liblab2
+// itself, on any of its threads, are the cache's own file I/O and always go
+// to libc.
+//
+// Set LAB2_PRELOAD_STATS to print the number of routed calls on exit.
+
+// The shim defines the functions that fortified headers inline
+#undef _FORTIFY_SOURCE
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <link.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+#include "lab2/Api.hpp"
+
+// Fortify entry points, declared by the headers only with _FORTIFY_SOURCE on.
+extern "C" {
+[[noreturn]] void __chk_fail();
+int __open_2(const char* path, int flags);
+int __open64_2(const char* path, int flags);
+int __openat_2(int dirfd, const char* path, int flags);
+int __openat64_2(int dirfd, const char* path, int flags);
+ssize_t __read_chk(int fd, void* buf, size_t count, size_t buf_size);
+ssize_t __pread_chk(int fd, void* buf, size_t count, off_t offset, size_t buf_size);
+ssize_t __pread64_chk(int fd, void* buf, size_t count, off64_t offset, size_t buf_size);
+}
+
+// The same layout on the 64-bit targets the shim is built for.
+static_assert(sizeof(struct stat) == sizeof(struct stat64));
+
+namespace {
+
+// Application fds above this are never routed.
+constexpr int KMaxFds = 4096;
+
+// Cache file shared by the application fds duplicated from one open.
+struct Route {
+  int cache_fd;
+  bool writable;
+  int refs;
+};
+
+struct RouteTable {
+  std::shared_mutex mutex;
+  std::array<std::shared_ptr<Route>, KMaxFds> routes;
+};
+
+// Never destroyed: the cache closes its files from static destructors that may
+// run after those of the shim.
+RouteTable& Routes() {
+  static auto* table = new RouteTable;
+  return *table;
+}
+
+std::atomic<bool> ready{false};
+const char* pattern = nullptr;  // From the environment, which outlives the shim
+int stats_fd = -1;  // Duplicate of stderr, which programs may close before exiting
+std::atomic<size_t> routed_opens{0};
+std::atomic<size_t> routed_reads{0};
+std::atomic<size_t> routed_writes{0};
+
+// Address range of liblab2's segments, where the cache's own calls come from.
+uintptr_t cache_begin = 0;
+uintptr_t cache_end = 0;
+
+// Address an exported function returns to, telling the cache's calls apart.
+#define LAB2_CALLER __builtin_return_address(0)
+
+template <typename Fn>
+Fn NextSymbol(const char* name) {
+  return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+// Declares real_<name>, the definition of name that the shim hides.
+#define LAB2_REAL(name) static const auto real_##name = NextSymbol<decltype(&::name)>(#name)
+
+bool Matches(const char* path, int dirfd) {
+  if (path == nullptr || pattern == nullptr || *pattern == '\0') {
+    return false;
+  }
+
+  std::string absolute;
+  if (path[0] == '/') {
+    absolute = path;
+  } else if (dirfd == AT_FDCWD) {
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+      return false;
+    }
+    absolute = std::string(cwd) + "/" + path;
+  } else {
+    return false;  // Relative to a directory fd
+  }
+
+  if (std::strpbrk(pattern, "*?[") != nullptr) {
+    return fnmatch(pattern, absolute.c_str(), 0) == 0;
+  }
+  return absolute.compare(0, std::strlen(pattern), pattern) == 0;
+}
+
+// Records the bounds of the object holding lab2_open among the loaded ones.
+int FindCache(dl_phdr_info* info, size_t /*size*/, void* /*data*/) {
+  const auto target = reinterpret_cast<uintptr_t>(&lab2_open);
+  uintptr_t begin = UINTPTR_MAX;
+  uintptr_t end = 0;
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& header = info->dlpi_phdr[i];
+    if (header.p_type == PT_LOAD) {
+      begin = std::min<uintptr_t>(begin, info->dlpi_addr + header.p_vaddr);
+      end = std::max<uintptr_t>(end, info->dlpi_addr + header.p_vaddr + header.p_memsz);
+    }
+  }
+  if (target < begin || target >= end) {
+    return 0;
+  }
+  cache_begin = begin;
+  cache_end = end;
+  return 1;
+}
+
+bool FromCache(const void* caller) {
+  const auto address = reinterpret_cast<uintptr_t>(caller);
+  return address >= cache_begin && address < cache_end;
+}
+
+bool ShouldRoute(int fd, const void* caller) {
+  return ready.load(std::memory_order_acquire) && !FromCache(caller) && fd >= 0 && fd < KMaxFds;
+}
+
+// Returns the route of an application fd, or nullptr if it isn't routed.
+std::shared_ptr<Route> FindRoute(int fd, const void* caller) {
+  if (!ShouldRoute(fd, caller)) {
+    return nullptr;
+  }
+  RouteTable& table = Routes();
+  const std::shared_lock<std::shared_mutex> lock(table.mutex);
+  return table.routes[fd];
+}
+
+// Detaches fd from its route, closing the cache file with its last fd.
+void DropRoute(int fd) {
+  if (fd < 0 || fd >= KMaxFds) {
+    return;
+  }
+
+  std::shared_ptr<Route> route;
+  {
+    RouteTable& table = Routes();
+    const std::unique_lock<std::shared_mutex> lock(table.mutex);
+    route = std::move(table.routes[fd]);
+    if (!route || --route->refs > 0) {
+      return;
+    }
+  }
+  lab2_close(route->cache_fd);
+}
+
+// Routes a file just opened by libc at fd through the cache, if it matches.
+void MaybeRoute(int fd, const char* path, int dirfd, int flags, const void* caller) {
+  if (!ShouldRoute(fd, caller)) {
+    return;
+  }
+  // A route left on a new fd belongs to a file closed behind the shim's back,
+  // e.g. by libc internals or a raw syscall
+  DropRoute(fd);
+  if ((flags & (O_APPEND | O_PATH | O_DIRECTORY)) != 0 || !Matches(path, dirfd)) {
+    return;
+  }
+
+  const int cache_fd = lab2_open(path);
+  if (cache_fd == -1) {
+    return;  // Served by libc, e.g. read-only files
+  }
+
+  const bool writable = (flags & O_ACCMODE) != O_RDONLY;
+  RouteTable& table = Routes();
+  const std::unique_lock<std::shared_mutex> lock(table.mutex);
+  table.routes[fd] = std::make_shared<Route>(Route{cache_fd, writable, 1});
+  ++routed_opens;
+}
+
+void ShareRoute(int old_fd, int new_fd, const void* caller) {
+  const std::shared_ptr<Route> route = FindRoute(old_fd, caller);
+  if (!route || new_fd < 0 || new_fd >= KMaxFds) {
+    return;
+  }
+  RouteTable& table = Routes();
+  const std::unique_lock<std::shared_mutex> lock(table.mutex);
+  ++route->refs;
+  table.routes[new_fd] = route;
+}
+
+// Reads through the cache at offset, setting errno on failure as the cache
+// doesn't.
+ssize_t RoutedPread(const Route& route, void* buf, size_t count, off_t offset) {
+  ++routed_reads;
+  lab2_read_req req = {route.cache_fd, offset, count, buf, -1};
+  lab2_read_batch(&req, 1);
+  if (req.result == -1) {
+    errno = offset < 0 ? EINVAL : EIO;
+  }
+  return req.result;
+}
+
+mode_t ModeArg(int flags, va_list args) {
+  return (flags & (O_CREAT | O_TMPFILE)) != 0 ? va_arg(args, mode_t) : 0;
+}
+
+// The calls below take the caller's address from their exported wrapper, so
+// that those forwarding to one another still see the original caller.
+
+ssize_t Read(int fd, void* buf, size_t count, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    ++routed_reads;
+    return lab2_read(route->cache_fd, buf, count);
+  }
+  LAB2_REAL(read);
+  return real_read(fd, buf, count);
+}
+
+ssize_t Pread(int fd, void* buf, size_t count, off_t offset, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    return RoutedPread(*route, buf, count, offset);
+  }
+  LAB2_REAL(pread);
+  return real_pread(fd, buf, count, offset);
+}
+
+ssize_t Pwrite(int fd, const void* buf, size_t count, off_t offset, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    if (!route->writable) {
+      errno = EBADF;
+      return -1;
+    }
+    ++routed_writes;
+    return lab2_pwrite(route->cache_fd, buf, count, offset);
+  }
+  LAB2_REAL(pwrite);
+  return real_pwrite(fd, buf, count, offset);
+}
+
+off_t Lseek(int fd, off_t offset, int whence, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    return lab2_lseek(route->cache_fd, offset, whence);
+  }
+  LAB2_REAL(lseek);
+  return real_lseek(fd, offset, whence);
+}
+
+int Fsync(int fd, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    return lab2_fsync(route->cache_fd);
+  }
+  LAB2_REAL(fsync);
+  return real_fsync(fd);
+}
+
+int Ftruncate(int fd, off_t length, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    if (!route->writable) {
+      errno = EBADF;
+      return -1;
+    }
+    return lab2_ftruncate(route->cache_fd, length);
+  }
+  LAB2_REAL(ftruncate);
+  return real_ftruncate(fd, length);
+}
+
+int Fstat(int fd, struct stat* st, const void* caller) {
+  if (const auto route = FindRoute(fd, caller)) {
+    return lab2_fstat(route->cache_fd, st);
+  }
+  LAB2_REAL(fstat);
+  return real_fstat(fd, st);
+}
+
+__attribute__((constructor)) void InitShim() {
+  dl_iterate_phdr(FindCache, nullptr);
+  pattern = std::getenv("LAB2_PRELOAD_PATTERN");
+  if (std::getenv("LAB2_PRELOAD_STATS") != nullptr) {
+    stats_fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+  }
+  ready.store(true, std::memory_order_release);
+}
+
+__attribute__((destructor)) void FiniShim() {
+  if (stats_fd != -1) {
+    dprintf(
+        stats_fd,
+        "lab2_preload: opens=%zu reads=%zu writes=%zu\n",
+        routed_opens.load(),
+        routed_reads.load(),
+        routed_writes.load()
+    );
+  }
+}
+
+}  // namespace
+
+extern "C" {
+
+int open(const char* path, int flags, ...) {
+  va_list args;
+  va_start(args, flags);
+  const mode_t mode = ModeArg(flags, args);
+  va_end(args);
+
+  LAB2_REAL(open);
+  const int fd = real_open(path, flags, mode);
+  MaybeRoute(fd, path, AT_FDCWD, flags, LAB2_CALLER);
+  return fd;
+}
+
+int open64(const char* path, int flags, ...) {
+  va_list args;
+  va_start(args, flags);
+  const mode_t mode = ModeArg(flags, args);
+  va_end(args);
+
+  LAB2_REAL(open64);
+  const int fd = real_open64(path, flags, mode);
+  MaybeRoute(fd, path, AT_FDCWD, flags, LAB2_CALLER);
+  return fd;
+}
+
+int openat(int dirfd, const char* path, int flags, ...) {
+  va_list args;
+  va_start(args, flags);
+  const mode_t mode = ModeArg(flags, args);
+  va_end(args);
+
+  LAB2_REAL(openat);
+  const int fd = real_openat(dirfd, path, flags, mode);
+  MaybeRoute(fd, path, dirfd, flags, LAB2_CALLER);
+  return fd;
+}
+
+int openat64(int dirfd, const char* path, int flags, ...) {
+  va_list args;
+  va_start(args, flags);
+  const mode_t mode = ModeArg(flags, args);
+  va_end(args);
+
+  LAB2_REAL(openat64);
+  const int fd = real_openat64(dirfd, path, flags, mode);
+  MaybeRoute(fd, path, dirfd, flags, LAB2_CALLER);
+  return fd;
+}
+
+// Fortified builds open through these when the flags aren't known at compile
+// time.
+int __open_2(const char* path, int flags) {
+  LAB2_REAL(__open_2);
+  const int fd = real___open_2(path, flags);
+  MaybeRoute(fd, path, AT_FDCWD, flags, LAB2_CALLER);
+  return fd;
+}
+
+int __open64_2(const char* path, int flags) {
+  LAB2_REAL(__open64_2);
+  const int fd = real___open64_2(path, flags);
+  MaybeRoute(fd, path, AT_FDCWD, flags, LAB2_CALLER);
+  return fd;
+}
+
+int __openat_2(int dirfd, const char* path, int flags) {
+  LAB2_REAL(__openat_2);
+  const int fd = real___openat_2(dirfd, path, flags);
+  MaybeRoute(fd, path, dirfd, flags, LAB2_CALLER);
+  return fd;
+}
+
+int __openat64_2(int dirfd, const char* path, int flags) {
+  LAB2_REAL(__openat64_2);
+  const int fd = real___openat64_2(dirfd, path, flags);
+  MaybeRoute(fd, path, dirfd, flags, LAB2_CALLER);
+  return fd;
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+  return Read(fd, buf, count, LAB2_CALLER);
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+  return Pread(fd, buf, count, offset, LAB2_CALLER);
+}
+
+ssize_t pread64(int fd, void* buf, size_t count, off64_t offset) {
+  return Pread(fd, buf, count, offset, LAB2_CALLER);
+}
+
+// Fortified builds call these when the buffer size is known at compile time.
+ssize_t __read_chk(int fd, void* buf, size_t count, size_t buf_size) {
+  if (count > buf_size) {
+    __chk_fail();
+  }
+  return Read(fd, buf, count, LAB2_CALLER);
+}
+
+ssize_t __pread_chk(int fd, void* buf, size_t count, off_t offset, size_t buf_size) {
+  if (count > buf_size) {
+    __chk_fail();
+  }
+  return Pread(fd, buf, count, offset, LAB2_CALLER);
+}
+
+ssize_t __pread64_chk(int fd, void* buf, size_t count, off64_t offset, size_t buf_size) {
+  if (count > buf_size) {
+    __chk_fail();
+  }
+  return Pread(fd, buf, count, offset, LAB2_CALLER);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+  if (const auto route = FindRoute(fd, LAB2_CALLER)) {
+    if (!route->writable) {
+      errno = EBADF;
+      return -1;
+    }
+    ++routed_writes;
+    return lab2_write(route->cache_fd, buf, count);
+  }
+  LAB2_REAL(write);
+  return real_write(fd, buf, count);
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  return Pwrite(fd, buf, count, offset, LAB2_CALLER);
+}
+
+ssize_t pwrite64(int fd, const void* buf, size_t count, off64_t offset) {
+  return Pwrite(fd, buf, count, offset, LAB2_CALLER);
+}
+
+off_t lseek(int fd, off_t offset, int whence) {
+  return Lseek(fd, offset, whence, LAB2_CALLER);
+}
+
+off64_t lseek64(int fd, off64_t offset, int whence) {
+  return Lseek(fd, offset, whence, LAB2_CALLER);
+}
+
+int fsync(int fd) {
+  return Fsync(fd, LAB2_CALLER);
+}
+
+int fdatasync(int fd) {
+  if (const auto route = FindRoute(fd, LAB2_CALLER)) {
+    return lab2_fsync(route->cache_fd);
+  }
+  LAB2_REAL(fdatasync);
+  return real_fdatasync(fd);
+}
+
+int ftruncate(int fd, off_t length) {
+  return Ftruncate(fd, length, LAB2_CALLER);
+}
+
+int ftruncate64(int fd, off64_t length) {
+  return Ftruncate(fd, length, LAB2_CALLER);
+}
+
+int fstat(int fd, struct stat* st) {
+  return Fstat(fd, st, LAB2_CALLER);
+}
+
+int fstat64(int fd, struct stat64* st) {
+  return Fstat(fd, reinterpret_cast<struct stat*>(st), LAB2_CALLER);
+}
+
+ssize_t copy_file_range(
+    int fd_in,
+    off64_t* off_in,
+    int fd_out,
+    off64_t* off_out,
+    size_t len,
+    unsigned int flags
+) {
+  // The kernel would bypass the cache, make the caller fall back to read/write
+  if (FindRoute(fd_in, LAB2_CALLER) || FindRoute(fd_out, LAB2_CALLER)) {
+    errno = EXDEV;
+    return -1;
+  }
+  LAB2_REAL(copy_file_range);
+  return real_copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+int dup(int old_fd) {
+  LAB2_REAL(dup);
+  const int fd = real_dup(old_fd);
+  if (fd != -1) {
+    ShareRoute(old_fd, fd, LAB2_CALLER);
+  }
+  return fd;
+}
+
+int dup2(int old_fd, int new_fd) {
+  LAB2_REAL(dup2);
+  const int fd = real_dup2(old_fd, new_fd);
+  if (fd != -1 && old_fd != new_fd) {
+    DropRoute(new_fd);
+    ShareRoute(old_fd, new_fd, LAB2_CALLER);
+  }
+  return fd;
+}
+
+int dup3(int old_fd, int new_fd, int flags) {
+  LAB2_REAL(dup3);
+  const int fd = real_dup3(old_fd, new_fd, flags);
+  if (fd != -1) {
+    DropRoute(new_fd);
+    ShareRoute(old_fd, new_fd, LAB2_CALLER);
+  }
+  return fd;
+}
+
+int close(int fd) {
+  if (ShouldRoute(fd, LAB2_CALLER)) {
+    DropRoute(fd);
+  }
+  LAB2_REAL(close);
+  return real_close(fd);
+}
+
+}  // extern "C"
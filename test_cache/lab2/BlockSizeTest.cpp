@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <type_traits>
+
+#include "lab2/Cache.hpp"
+#include "lab2/SharedTier.hpp"
+
+namespace lab2 {
+
+template <typename Size>
+class BlockSizeTest : public ::testing::Test {
+protected:
+  static constexpr size_t KSize = Size::value;
+
+  std::string dataPath = "/tmp/block_size_test.tmp";
+  std::string victimPath = "/tmp/block_size_test_victim.tmp";
+  std::string journalPath = "/tmp/block_size_test_journal.tmp";
+  std::string tierName = "/lab2_block_size_test";
+
+  void SetUp() override {
+    TearDown();
+  }
+
+  void TearDown() override {
+    unlink(dataPath.c_str());
+    unlink(victimPath.c_str());
+    unlink(journalPath.c_str());
+    SharedTier::Unlink(tierName);
+  }
+
+  // Bytes of a test pattern that doesn't repeat at block boundaries.
+  static std::string Pattern(size_t size) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<char>('a' + (i * 7 + i / 4093) % 26);
+    }
+    return data;
+  }
+
+  // Bytes that compress to about half their size: random bytes alternating
+  // with runs of zeros.
+  static std::string HalfCompressible(size_t size) {
+    std::mt19937 engine(7);
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; i += 1024) {
+      for (size_t j = i; j < std::min(size, i + 512); ++j) {
+        data[j] = static_cast<char>(engine());
+      }
+    }
+    return data;
+  }
+};
+
+using BlockSizes = ::testing::Types<
+    std::integral_constant<size_t, 4096>,
+    std::integral_constant<size_t, 16 * 1024>,
+    std::integral_constant<size_t, 64 * 1024>>;
+TYPED_TEST_SUITE(BlockSizeTest, BlockSizes);
+
+// Test that unaligned writes and reads spanning blocks survive eviction and reopening
+TYPED_TEST(BlockSizeTest, RoundTrip) {
+  constexpr size_t KSize = TestFixture::KSize;
+  const std::string data = TestFixture::Pattern(10 * KSize + 123);
+  {
+    BasicFIFOCache<KSize> cache(4);
+    const int fd = cache.OpenFile(this->dataPath);
+    ASSERT_GE(fd, 0) << "Failed to open file";
+    ASSERT_EQ(cache.LSeek(fd, 100, SEEK_SET), 100);
+    ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+    ASSERT_EQ(cache.GetStats().frames, 4U);
+    ASSERT_EQ(cache.CloseFile(fd), 0);
+  }
+
+  BasicFIFOCache<KSize> cache(4);
+  const int fd = cache.OpenFile(this->dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  struct stat st = {};
+  ASSERT_EQ(cache.StatFile(fd, &st), 0);
+  ASSERT_EQ(st.st_size, static_cast<off_t>(100 + data.size())) << "Whole-block tail not trimmed";
+
+  std::string buffer(data.size(), '\0');
+  ASSERT_EQ(cache.LSeek(fd, 100, SEEK_SET), 100);
+  ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(buffer, data);
+  ASSERT_EQ(cache.GetStats().misses, 11U) << "Expected one miss per block";
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that the lower tiers and the journal work in blocks of the cache's size
+TYPED_TEST(BlockSizeTest, TiersAndJournal) {
+  constexpr size_t KSize = TestFixture::KSize;
+  CacheOptions options;
+  options.victim_cache_path = this->victimPath;
+  options.victim_cache_blocks = 16;
+  options.shared_tier_name = this->tierName;
+  options.shared_tier_blocks = 64;
+  options.journal_path = this->journalPath;
+  const std::string data = TestFixture::Pattern(8 * KSize);
+
+  BasicFIFOCache<KSize> cache(2, options);
+  const int fd = cache.OpenFile(this->dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+
+  std::string buffer(data.size(), '\0');
+  for (int pass = 0; pass < 2; ++pass) {
+    ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(data.size()));
+    ASSERT_EQ(buffer, data) << "Pass " << pass;
+  }
+  const CacheStats stats = cache.GetStats();
+  ASSERT_GT(stats.shared_hits + stats.victim_hits, 0U) << "No miss was served by a lower tier";
+  ASSERT_EQ(stats.journal_commits, 1U);
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that the compressed tier keeps compressible blocks of the cache's size
+TYPED_TEST(BlockSizeTest, CompressedTier) {
+  constexpr size_t KSize = TestFixture::KSize;
+  CacheOptions options;
+  options.compressed_tier = true;
+  const std::string data = TestFixture::HalfCompressible(32 * KSize);
+
+  BasicFIFOCache<KSize> cache(16, options);
+  const int fd = cache.OpenFile(this->dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+
+  // Backwards, so that the blocks evicted last are read while still compressed
+  std::string buffer(KSize, '\0');
+  for (size_t block = 32; block-- > 0;) {
+    const off_t offset = static_cast<off_t>(block * KSize);
+    ASSERT_EQ(cache.LSeek(fd, offset, SEEK_SET), offset);
+    ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KSize));
+    ASSERT_EQ(buffer, data.substr(offset, KSize)) << "Block " << block;
+  }
+  const CacheStats stats = cache.GetStats();
+  ASSERT_GT(stats.compressed_hits, 0U);
+  ASSERT_EQ(stats.compressed_rejected, 0U) << "Compressible blocks were rejected";
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that CreateCache picks the instantiation of the requested block size
+TYPED_TEST(BlockSizeTest, CreateCache) {
+  constexpr size_t KSize = TestFixture::KSize;
+  const auto cache = CreateCache(KSize, 8);
+  ASSERT_NE(cache, nullptr);
+  ASSERT_EQ(cache->GetBlockSize(), KSize);
+  ASSERT_NE(dynamic_cast<BasicFIFOCache<KSize>*>(cache.get()), nullptr);
+
+  const int fd = cache->OpenFile(this->dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  const std::string data = TestFixture::Pattern(KSize + 1);
+  ASSERT_EQ(cache->WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(cache->GetStats().frames, 2U);
+  ASSERT_EQ(cache->CloseFile(fd), 0);
+
+  ASSERT_EQ(CreateCache(KSize / 2, 8), nullptr);
+}
+
+}  // namespace lab2
@@ -1,6 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
 #include "lab2/Api.hpp"
+#include "lab2/Cache.hpp"
 
 namespace lab2 {
 
@@ -183,6 +189,156 @@ TEST_F(CacheTest, CacheEvictionLRU) {
   fd = -1;  // Mark as closed
 }
 
+// Test batched positional reads, including duplicates, block-spanning ranges and EOF
+TEST_F(CacheTest, ReadBatch) {
+  fd = lab2_open(tempFilePath.c_str());
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const size_t blockSize = 4096;
+  const size_t numBlocks = 8;
+  for (size_t i = 0; i < numBlocks; ++i) {
+    char writeData[blockSize];
+    memset(writeData, 'a' + i, blockSize);
+    ASSERT_EQ(lab2_write(fd, writeData, blockSize), static_cast<ssize_t>(blockSize));
+  }
+
+  // Reopen the file so that the batch has to go to disk
+  ASSERT_EQ(lab2_close(fd), 0) << "Failed to close file";
+  fd = lab2_open(tempFilePath.c_str());
+  ASSERT_GE(fd, 0) << "Failed to reopen file";
+
+  char first[16] = {0};
+  char duplicate[16] = {0};
+  char spanning[2 * blockSize] = {0};
+  char tail[blockSize] = {0};
+  char invalid[16] = {0};
+  lab2_read_req reqs[] = {
+      {fd, 0, sizeof(first), first, 0},
+      {fd, 8, sizeof(duplicate), duplicate, 0},
+      {fd, 3 * blockSize - blockSize / 2, sizeof(spanning), spanning, 0},
+      {fd, (numBlocks - 1) * blockSize + 100, sizeof(tail), tail, 0},
+      {-1, 0, sizeof(invalid), invalid, 0},
+  };
+
+  ASSERT_EQ(lab2_read_batch(reqs, 5), 4) << "Unexpected number of successful requests";
+
+  ASSERT_EQ(reqs[0].result, static_cast<ssize_t>(sizeof(first)));
+  ASSERT_EQ(std::string(first, sizeof(first)), std::string(sizeof(first), 'a'));
+  ASSERT_EQ(reqs[1].result, static_cast<ssize_t>(sizeof(duplicate)));
+  ASSERT_EQ(std::string(duplicate, sizeof(duplicate)), std::string(sizeof(duplicate), 'a'));
+
+  ASSERT_EQ(reqs[2].result, static_cast<ssize_t>(sizeof(spanning)));
+  ASSERT_EQ(spanning[0], 'c');
+  ASSERT_EQ(spanning[blockSize / 2], 'd');
+  ASSERT_EQ(spanning[sizeof(spanning) - 1], 'e');
+
+  ASSERT_EQ(reqs[3].result, static_cast<ssize_t>(blockSize - 100)) << "Read past EOF";
+  ASSERT_EQ(tail[0], 'h');
+
+  ASSERT_EQ(reqs[4].result, -1) << "Invalid file descriptor should fail";
+
+  // The same batch is now served from the cache
+  ASSERT_EQ(lab2_read_batch(reqs, 4), 4);
+  ASSERT_EQ(spanning[blockSize + blockSize / 2], 'e');
+
+  ASSERT_EQ(lab2_close(fd), 0) << "Failed to close file";
+  fd = -1;  // Mark as closed
+}
+
+// Test that batches missing blocks rewritten around the cache while their reads
+// are in flight never cache the older contents
+TEST_F(CacheTest, ReadBatchRacesWrites) {
+  const size_t blockSize = 4096;
+  const size_t numBlocks = 32;
+  FIFOCache cache(numBlocks / 4);
+  fd = cache.OpenFile(tempFilePath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  // Writes go straight to disk, and batches of more blocks than the cache holds keep missing
+  ASSERT_EQ(cache.SetWriteMode(fd, LAB2_WRITE_AROUND), 0);
+
+  // Each block starts with the number of the pass that last wrote it
+  auto write_pass = [&](int pass) {
+    std::string data(blockSize, 'a');
+    std::memcpy(data.data(), &pass, sizeof(pass));
+    for (size_t i = 0; i < numBlocks; ++i) {
+      cache.PWriteFile(fd, data.data(), data.size(), i * blockSize);
+    }
+  };
+  write_pass(0);
+
+  std::atomic<int> passes_done{0};
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    for (int pass = 1; !stop; ++pass) {
+      write_pass(pass);
+      passes_done = pass;
+    }
+  });
+
+  // Every other block, so that the misses form several runs
+  std::vector<std::string> buffers(numBlocks / 2, std::string(blockSize, '\0'));
+  bool stale = false;
+  for (int round = 0; round < 2000 && !stale; ++round) {
+    const int passes_before = passes_done;
+    std::vector<lab2_read_req> reqs;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      reqs.push_back({fd, static_cast<off_t>(2 * i * blockSize), blockSize, buffers[i].data(), 0});
+    }
+    ASSERT_EQ(cache.ReadBatch(reqs.data(), reqs.size()), static_cast<ssize_t>(reqs.size()));
+    for (const auto& buffer : buffers) {
+      int pass = 0;
+      std::memcpy(&pass, buffer.data(), sizeof(pass));
+      stale = stale || pass < passes_before;
+    }
+  }
+  stop = true;
+  writer.join();
+  ASSERT_FALSE(stale) << "Batch served a block older than a completed write";
+
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+  fd = -1;  // Mark as closed
+}
+
+// Test that the file size includes unflushed writes and truncation
+TEST_F(CacheTest, LogicalFileSize) {
+  const size_t blockSize = 4096;
+  fd = lab2_open(tempFilePath.c_str());
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const std::string data(blockSize + 100, 'a');
+  ASSERT_EQ(lab2_write(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(lab2_lseek(fd, 0, SEEK_END), static_cast<off_t>(data.size()))
+      << "SEEK_END should include cached writes";
+
+  struct stat st = {};
+  ASSERT_EQ(lab2_fstat(fd, &st), 0);
+  ASSERT_EQ(st.st_size, static_cast<off_t>(data.size()));
+
+  char buffer[256];
+  ASSERT_EQ(lab2_lseek(fd, blockSize, SEEK_SET), static_cast<off_t>(blockSize));
+  ASSERT_EQ(lab2_read(fd, buffer, sizeof(buffer)), 100) << "Read should stop at EOF";
+
+  // Shrinking drops the tail, growing again exposes zeros
+  ASSERT_EQ(lab2_ftruncate(fd, 10), 0);
+  ASSERT_EQ(lab2_lseek(fd, 0, SEEK_END), 10);
+  ASSERT_EQ(lab2_lseek(fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(lab2_read(fd, buffer, sizeof(buffer)), 10);
+  ASSERT_EQ(lab2_ftruncate(fd, 20), 0);
+  ASSERT_EQ(lab2_lseek(fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(lab2_read(fd, buffer, sizeof(buffer)), 20);
+  ASSERT_EQ(std::string(buffer, 20), std::string(10, 'a') + std::string(10, '\0'));
+
+  // Whole-block writeback is cut back to the logical size on sync
+  ASSERT_EQ(lab2_write(fd, "tail", 4), 4);
+  ASSERT_EQ(lab2_fsync(fd), 0);
+  ASSERT_EQ(stat(tempFilePath.c_str(), &st), 0);
+  ASSERT_EQ(st.st_size, 24) << "File on disk should have the logical size";
+
+  ASSERT_EQ(lab2_ftruncate(fd, -1), -1) << "Negative length should fail";
+  ASSERT_EQ(lab2_close(fd), 0) << "Failed to close file";
+  fd = -1;  // Mark as closed
+}
+
 // Test handling of invalid file descriptor
 TEST_F(CacheTest, InvalidFileDescriptor) {
   int invalidFd = -1;
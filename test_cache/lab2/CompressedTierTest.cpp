@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lab2/Cache.hpp"
+#include "lab2/CompressedTier.hpp"
+#include "lab2/Lz.hpp"
+
+namespace lab2 {
+
+namespace {
+
+std::string MakeTextBlock(int seed) {
+  std::string text;
+  while (text.size() < KBlockSize) {
+    text += "{\"seq\": " + std::to_string(seed++) + ", \"level\": \"info\", \"msg\": \"ok\"}\n";
+  }
+  text.resize(KBlockSize);
+  return text;
+}
+
+std::string MakeRandomBlock(unsigned seed) {
+  std::mt19937 engine(seed);
+  std::string data(KBlockSize, '\0');
+  for (auto& byte : data) {
+    byte = static_cast<char>(engine());
+  }
+  return data;
+}
+
+}  // namespace
+
+// Test that the codec round-trips text and gives up on random data
+TEST(LzTest, RoundTrip) {
+  const std::string text = MakeTextBlock(0);
+  std::vector<char> compressed(KBlockSize);
+  const size_t compressed_size =
+      LzCompress(text.data(), text.size(), compressed.data(), compressed.size());
+  ASSERT_GT(compressed_size, 0U);
+  ASSERT_LT(compressed_size, text.size() / 2) << "Text should compress well";
+
+  std::string restored(KBlockSize, '\0');
+  ASSERT_EQ(
+      LzDecompress(compressed.data(), compressed_size, restored.data(), restored.size()),
+      static_cast<ssize_t>(text.size())
+  );
+  ASSERT_EQ(restored, text);
+
+  const std::string noise = MakeRandomBlock(1);
+  ASSERT_EQ(LzCompress(noise.data(), noise.size(), compressed.data(), KBlockSize * 3 / 4), 0U)
+      << "Random data should not fit";
+}
+
+// Test that incompressible blocks are rejected and the budget is respected
+TEST(CompressedTierTest, BudgetAndRejection) {
+  CompressedTier tier(4 * KBlockSize);
+
+  const std::string noise = MakeRandomBlock(2);
+  ASSERT_FALSE(tier.Put(1, noise.data(), noise.size()));
+  ASSERT_EQ(tier.GetStats().rejected, 1U);
+
+  for (uint64_t id = 0; id < 64; ++id) {
+    const std::string text = MakeTextBlock(static_cast<int>(id));
+    ASSERT_TRUE(tier.Put(id, text.data(), text.size()));
+    ASSERT_LE(tier.GetStats().used_bytes, 4 * KBlockSize);
+  }
+  ASSERT_GT(tier.GetStats().evicted, 0U);
+
+  AlignedVec data;
+  ASSERT_FALSE(tier.Take(0, data)) << "Oldest entry should have been evicted";
+  ASSERT_TRUE(tier.Take(63, data));
+  ASSERT_EQ(std::string(data.begin(), data.end()), MakeTextBlock(63));
+  ASSERT_FALSE(tier.Take(63, data)) << "Take should remove the entry";
+}
+
+// Test that misses are served from the compressed tier with the right data
+TEST(CompressedTierTest, CacheServesMissesFromTier) {
+  const std::string path = "/tmp/compressed_tier_test.tmp";
+  unlink(path.c_str());
+
+  CacheOptions options;
+  options.compressed_tier = true;
+  FIFOCache cache(32, options);
+
+  const int fd = cache.OpenFile(path);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const int numBlocks = 40;
+  for (int i = 0; i < numBlocks; ++i) {
+    const std::string text = MakeTextBlock(i * 1000);
+    ASSERT_EQ(cache.WriteFile(fd, text.data(), text.size()), static_cast<ssize_t>(text.size()));
+  }
+
+  for (int round = 0; round < 2; ++round) {
+    ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+    for (int i = 0; i < numBlocks; ++i) {
+      std::string buffer(KBlockSize, '\0');
+      ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+      ASSERT_EQ(buffer, MakeTextBlock(i * 1000)) << "Data mismatch at block " << i;
+    }
+  }
+
+  const CacheStats stats = cache.GetStats();
+  ASSERT_GT(stats.compressed_hits, 0U) << "No miss was served by the compressed tier";
+  ASSERT_GT(stats.compressed_capacity, 0U);
+
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+  unlink(path.c_str());
+}
+
+}  // namespace lab2
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "lab2/Cache.hpp"
+#include "lab2/Frame.hpp"
+
+namespace lab2 {
+
+class DedupTest : public ::testing::Test {
+protected:
+  std::string firstPath = "/tmp/dedup_test_1.tmp";
+  std::string secondPath = "/tmp/dedup_test_2.tmp";
+
+  void SetUp() override {
+    unlink(firstPath.c_str());
+    unlink(secondPath.c_str());
+  }
+
+  void TearDown() override {
+    unlink(firstPath.c_str());
+    unlink(secondPath.c_str());
+  }
+};
+
+// Test the zero check with a single non-zero byte at every position
+TEST(FrameTest, ZeroCheck) {
+  std::string data(KBlockSize + 13, '\0');
+  ASSERT_TRUE(IsZeroFrame(data.data(), data.size()));
+  for (size_t pos = 0; pos < data.size(); ++pos) {
+    data[pos] = 1;
+    ASSERT_FALSE(IsZeroFrame(data.data(), data.size())) << "Missed byte " << pos;
+    data[pos] = 0;
+  }
+}
+
+// Test that zero blocks don't take frames and are copied on write
+TEST_F(DedupTest, ZeroBlocksShareFrame) {
+  FIFOCache cache(8);
+
+  const int fd = cache.OpenFile(firstPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const int numBlocks = 64;
+  const std::string zeros(KBlockSize, '\0');
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_EQ(cache.WriteFile(fd, zeros.data(), zeros.size()), static_cast<ssize_t>(KBlockSize));
+  }
+
+  CacheStats stats = cache.GetStats();
+  ASSERT_EQ(stats.zero_blocks, static_cast<size_t>(numBlocks)) << "Zero blocks were evicted";
+  ASSERT_EQ(stats.frames, 0U);
+
+  ASSERT_EQ(cache.LSeek(fd, 5 * KBlockSize + 7, SEEK_SET), 5 * KBlockSize + 7);
+  ASSERT_EQ(cache.WriteFile(fd, "x", 1), 1);
+  ASSERT_EQ(cache.GetStats().frames, 1U);
+
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  for (int i = 0; i < numBlocks; ++i) {
+    std::string buffer(KBlockSize, 'q');
+    ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+    std::string expected = zeros;
+    if (i == 5) {
+      expected[7] = 'x';
+    }
+    ASSERT_EQ(buffer, expected) << "Data mismatch at block " << i;
+  }
+
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+  ASSERT_EQ(cache.GetStats().frames, 0U);
+}
+
+// Test that identical clean blocks of different files share one frame
+TEST_F(DedupTest, IdenticalBlocksShareFrame) {
+  CacheOptions options;
+  options.dedup_blocks = true;
+  FIFOCache cache(16, options);
+
+  const std::string data(KBlockSize, 'd');
+  for (const auto& path : {firstPath, secondPath}) {
+    const int fd = cache.OpenFile(path);
+    ASSERT_GE(fd, 0) << "Failed to open file";
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(KBlockSize));
+    }
+    ASSERT_EQ(cache.CloseFile(fd), 0);
+  }
+
+  const int first = cache.OpenFile(firstPath);
+  const int second = cache.OpenFile(secondPath);
+  std::string buffer(4 * KBlockSize, '\0');
+  ASSERT_EQ(cache.ReadFile(first, buffer.data(), buffer.size()), 4 * KBlockSize);
+  ASSERT_EQ(cache.ReadFile(second, buffer.data(), buffer.size()), 4 * KBlockSize);
+
+  CacheStats stats = cache.GetStats();
+  ASSERT_EQ(stats.deduplicated_blocks, 8U);
+  ASSERT_EQ(stats.frames, 1U);
+
+  // Modifying one block must not leak into the others
+  ASSERT_EQ(cache.LSeek(first, 0, SEEK_SET), 0);
+  ASSERT_EQ(cache.WriteFile(first, "new", 3), 3);
+  ASSERT_EQ(cache.LSeek(second, 0, SEEK_SET), 0);
+  ASSERT_EQ(cache.ReadFile(second, buffer.data(), 3), 3);
+  ASSERT_EQ(buffer.substr(0, 3), "ddd");
+  ASSERT_EQ(cache.GetStats().frames, 2U);
+
+  ASSERT_EQ(cache.CloseFile(first), 0);
+  ASSERT_EQ(cache.CloseFile(second), 0);
+}
+
+}  // namespace lab2
@@ -0,0 +1,237 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lab2/Cache.hpp"
+
+namespace lab2 {
+
+class JournalTest : public ::testing::Test {
+protected:
+  std::string journalPath = "/tmp/journal_test.journal";
+  std::vector<std::string> dataPaths = {
+      "/tmp/journal_test_0.tmp",
+      "/tmp/journal_test_1.tmp",
+      "/tmp/journal_test_2.tmp",
+      "/tmp/journal_test_3.tmp",
+  };
+
+  void SetUp() override {
+    unlink(journalPath.c_str());
+    for (const auto& path : dataPaths) {
+      unlink(path.c_str());
+    }
+  }
+
+  void TearDown() override {
+    unlink(journalPath.c_str());
+    for (const auto& path : dataPaths) {
+      unlink(path.c_str());
+    }
+  }
+
+  static std::string ReadHome(const std::string& path) {
+    std::string contents(64 * KBlockSize, '\0');
+    const int fd = open(path.c_str(), O_RDONLY);
+    const ssize_t size = fd == -1 ? 0 : pread(fd, contents.data(), contents.size(), 0);
+    close(fd);
+    contents.resize(size > 0 ? size : 0);
+    return contents;
+  }
+};
+
+// Test concurrent syncs sharing journal flushes and checkpointing home
+TEST_F(JournalTest, GroupCommitAndCheckpoint) {
+  const int numSyncs = 20;
+  {
+    CacheOptions options;
+    options.journal_path = journalPath;
+    options.journal_checkpoint_bytes = 16 * KBlockSize;
+    FIFOCache cache(64, options);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < dataPaths.size(); ++t) {
+      threads.emplace_back([&, t] {
+        const int fd = cache.OpenFile(dataPaths[t]);
+        ASSERT_GE(fd, 0) << "Failed to open file";
+        for (int i = 0; i < numSyncs; ++i) {
+          const std::string data(KBlockSize, static_cast<char>('a' + i));
+          ASSERT_EQ(
+              cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(data.size())
+          );
+          ASSERT_EQ(cache.SyncFile(fd), 0);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    const CacheStats stats = cache.GetStats();
+    ASSERT_EQ(stats.journal_commits, dataPaths.size() * numSyncs);
+    ASSERT_GT(stats.journal_syncs, 0U);
+    ASSERT_LE(stats.journal_syncs, stats.journal_commits);
+
+    for (int attempt = 0; attempt < 100 && cache.GetStats().checkpoints == 0; ++attempt) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(cache.GetStats().checkpoints, 0U) << "The journal was never checkpointed";
+  }
+
+  // Destroying the cache checkpoints everything and empties the journal
+  struct stat st = {};
+  ASSERT_EQ(stat(journalPath.c_str(), &st), 0);
+  ASSERT_EQ(st.st_size, 0);
+  for (const auto& path : dataPaths) {
+    const std::string contents = ReadHome(path);
+    ASSERT_EQ(contents.size(), numSyncs * KBlockSize);
+    for (int i = 0; i < numSyncs; ++i) {
+      ASSERT_EQ(contents[i * KBlockSize], static_cast<char>('a' + i)) << "Block " << i;
+    }
+  }
+}
+
+// Test that rewrites and truncates racing background checkpoints end up home
+TEST_F(JournalTest, CheckpointRacesRewrites) {
+  const std::string& path = dataPaths[0];
+  std::string expected;
+  {
+    CacheOptions options;
+    options.journal_path = journalPath;
+    options.journal_checkpoint_bytes = 4 * KBlockSize;
+    FIFOCache cache(6, options);
+    const int fd = cache.OpenFile(path);
+    ASSERT_GE(fd, 0) << "Failed to open file";
+
+    for (int i = 0; i < 400; ++i) {
+      if (i % 50 == 49) {
+        const size_t length = 6 * KBlockSize - 100;
+        ASSERT_EQ(cache.TruncateFile(fd, static_cast<off_t>(length)), 0);
+        expected.resize(std::min(expected.size(), length));
+      } else {
+        const size_t offset = (i * 5 % 8) * KBlockSize;
+        const std::string data(KBlockSize, static_cast<char>('a' + i % 26));
+        ASSERT_EQ(
+            cache.PWriteFile(fd, data.data(), data.size(), static_cast<off_t>(offset)),
+            static_cast<ssize_t>(data.size())
+        );
+        expected.resize(std::max(expected.size(), offset + data.size()), '\0');
+        expected.replace(offset, data.size(), data);
+      }
+      ASSERT_EQ(cache.SyncFile(fd), 0);
+    }
+    for (int attempt = 0; attempt < 100 && cache.GetStats().checkpoints == 0; ++attempt) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(cache.GetStats().checkpoints, 0U) << "The journal was never checkpointed";
+  }
+
+  ASSERT_EQ(ReadHome(path), expected);
+}
+
+// Test that writebacks are journaled only after a commit of their file, and
+// that they then get the journal checkpointed without any further sync
+TEST_F(JournalTest, WritebacksKeepJournalBounded) {
+  const std::string& path = dataPaths[0];
+  CacheOptions options;
+  options.journal_path = journalPath;
+  options.journal_checkpoint_bytes = 8 * KBlockSize;
+  FIFOCache cache(4, options);
+  const int fd = cache.OpenFile(path);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  auto journal_size = [this] {
+    struct stat stat_data = {};
+    return stat(journalPath.c_str(), &stat_data) == 0 ? stat_data.st_size : -1;
+  };
+  auto write_blocks = [&](char value) {
+    const std::string data(KBlockSize, value);
+    for (int i = 0; i < 32; ++i) {
+      ASSERT_EQ(
+          cache.PWriteFile(fd, data.data(), data.size(), static_cast<off_t>(i) * KBlockSize),
+          static_cast<ssize_t>(data.size())
+      );
+    }
+  };
+
+  // Evictions write the blocks back, with nothing in the journal to protect
+  write_blocks('a');
+  ASSERT_EQ(journal_size(), 0) << "Writebacks of an uncommitted file were journaled";
+
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+  write_blocks('b');
+  for (int attempt = 0; attempt < 100 && cache.GetStats().checkpoints == 0; ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_GT(cache.GetStats().checkpoints, 0U) << "Journaled writebacks never checkpointed";
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that a truncate after a commit is not undone by replaying the commit
+TEST_F(JournalTest, ReplayKeepsTruncate) {
+  const std::string& path = dataPaths[0];
+  CacheOptions options;
+  options.journal_path = journalPath;
+
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Skips the destructor, leaving the commit in the journal only
+    auto* cache = new FIFOCache(16, options);
+    const int fd = cache->OpenFile(path);
+    const std::string committed(2 * KBlockSize, 'c');
+    cache->WriteFile(fd, committed.data(), committed.size());
+    cache->SyncFile(fd);
+    cache->TruncateFile(fd, 100);
+    _exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+
+  {
+    FIFOCache cache(16, options);
+    ASSERT_EQ(ReadHome(path), std::string(100, 'c')) << "Replay undid the truncate";
+  }
+}
+
+// Test that committed syncs survive a crash and uncommitted writes don't
+TEST_F(JournalTest, ReplayAfterCrash) {
+  const std::string& path = dataPaths[0];
+  CacheOptions options;
+  options.journal_path = journalPath;
+
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Skips the destructor, leaving the commits in the journal only
+    auto* cache = new FIFOCache(16, options);
+    const int fd = cache->OpenFile(path);
+    const std::string committed(KBlockSize + 10, 'c');
+    cache->WriteFile(fd, committed.data(), committed.size());
+    cache->SyncFile(fd);
+    const std::string lost(KBlockSize, 'x');
+    cache->WriteFile(fd, lost.data(), lost.size());
+    _exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_TRUE(ReadHome(path).empty()) << "Commits should not have been written home";
+
+  {
+    FIFOCache cache(16, options);
+    const std::string contents = ReadHome(path);
+    ASSERT_EQ(contents, std::string(KBlockSize + 10, 'c')) << "Commit not replayed";
+  }
+}
+
+}  // namespace lab2
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "lab2/Cache.hpp"
+#include "lab2/TestUtil.hpp"
+
+namespace lab2 {
+
+class PartitionTest : public ::testing::Test {
+protected:
+  std::string hotPath = "/tmp/partition_test_hot.tmp";
+  std::string scanPath = "/tmp/partition_test_scan.tmp";
+
+  void SetUp() override {
+    unlink(hotPath.c_str());
+    unlink(scanPath.c_str());
+  }
+
+  void TearDown() override {
+    unlink(hotPath.c_str());
+    unlink(scanPath.c_str());
+  }
+
+  static PartitionStats FindPartition(FIFOCache& cache, const std::string& name) {
+    for (const auto& partition : cache.GetStats().partitions) {
+      if (partition.name == name) {
+        return partition;
+      }
+    }
+    ADD_FAILURE() << "No partition " << name;
+    return {};
+  }
+};
+
+// Test that a scan in one partition doesn't evict another's guaranteed share
+TEST_F(PartitionTest, GuaranteedShareSurvivesScan) {
+  FIFOCache cache(64);
+  ASSERT_EQ(cache.CreatePartition("hot", 25, 50), 0);
+  ASSERT_EQ(cache.CreatePartition("hot", 10, 20), -1) << "Duplicate name should fail";
+  ASSERT_EQ(cache.CreatePartition("greedy", 80, 100), -1) << "Guarantees above 100% should fail";
+
+  const lab2_open_options hot_options = {"hot", LAB2_WRITE_BACK};
+  const int hot_fd = cache.OpenFile(hotPath, &hot_options);
+  ASSERT_GE(hot_fd, 0) << "Failed to open file";
+  const lab2_open_options unknown_options = {"unknown", LAB2_WRITE_BACK};
+  ASSERT_EQ(cache.OpenFile(hotPath, &unknown_options), -1) << "Unknown partition should fail";
+  const int scan_fd = cache.OpenFile(scanPath);
+  ASSERT_GE(scan_fd, 0) << "Failed to open file";
+
+  const int hotBlocks = 16;
+  WriteBlocks(cache, hot_fd, hotBlocks);
+  WriteBlocks(cache, scan_fd, 256);
+  ReadBlocks(cache, scan_fd, 256);
+
+  const size_t hot_hits = FindPartition(cache, "hot").hits;
+  ReadBlocks(cache, hot_fd, hotBlocks);
+  const PartitionStats hot = FindPartition(cache, "hot");
+  ASSERT_EQ(hot.hits - hot_hits, static_cast<size_t>(hotBlocks)) << "Hot blocks were evicted";
+  ASSERT_EQ(hot.evictions, 0U);
+  ASSERT_GT(FindPartition(cache, "default").evictions, 0U);
+
+  ASSERT_EQ(cache.CloseFile(hot_fd), 0);
+  ASSERT_EQ(cache.CloseFile(scan_fd), 0);
+}
+
+// Test that a partition borrows idle capacity only up to its maximum share
+TEST_F(PartitionTest, MaximumShare) {
+  FIFOCache cache(64);
+  ASSERT_EQ(cache.CreatePartition("capped", 0, 25), 0);
+
+  const lab2_open_options options = {"capped", LAB2_WRITE_BACK};
+  const int fd = cache.OpenFile(hotPath, &options);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  WriteBlocks(cache, fd, 48);
+  const PartitionStats capped = FindPartition(cache, "capped");
+  ASSERT_EQ(capped.max_blocks, 16U);
+  ASSERT_LE(capped.blocks, capped.max_blocks);
+  ASSERT_GT(capped.evictions, 0U);
+
+  // The data evicted within the partition is still readable
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  std::string buffer(KBlockSize, '\0');
+  ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+  ASSERT_EQ(buffer, std::string(KBlockSize, 'a'));
+
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+}  // namespace lab2
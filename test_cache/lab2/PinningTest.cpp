@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+
+#include "lab2/Cache.hpp"
+#include "lab2/TestUtil.hpp"
+
+namespace lab2 {
+
+class PinningTest : public ::testing::Test {
+protected:
+  std::string indexPath = "/tmp/pinning_test_index.tmp";
+  std::string dataPath = "/tmp/pinning_test_data.tmp";
+  std::string bulkPath = "/tmp/pinning_test_bulk.tmp";
+
+  void SetUp() override {
+    unlink(indexPath.c_str());
+    unlink(dataPath.c_str());
+    unlink(bulkPath.c_str());
+  }
+
+  void TearDown() override {
+    unlink(indexPath.c_str());
+    unlink(dataPath.c_str());
+    unlink(bulkPath.c_str());
+  }
+
+  // Writes numBlocks different blocks, each compressing to about a quarter.
+  static void WriteCompressibleBlocks(FIFOCache& cache, int fd, int numBlocks) {
+    std::mt19937 engine(fd);
+    for (int i = 0; i < numBlocks; ++i) {
+      std::string chunk(KBlockSize / 4, '\0');
+      for (auto& byte : chunk) {
+        byte = static_cast<char>(engine());
+      }
+      std::string data;
+      while (data.size() < KBlockSize) {
+        data += chunk;
+      }
+      ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(KBlockSize));
+    }
+  }
+
+  // Number of the file's first numBlocks blocks still in the cache.
+  static size_t CountResident(FIFOCache& cache, int fd, int numBlocks) {
+    const size_t hits = cache.GetStats().hits;
+    ReadBlocks(cache, fd, numBlocks);
+    return cache.GetStats().hits - hits;
+  }
+};
+
+// Test that pinned blocks survive a scan, up to the pinned memory cap
+TEST_F(PinningTest, PinnedRangeSurvivesScan) {
+  FIFOCache cache(64);
+  const int index_fd = cache.OpenFile(indexPath);
+  ASSERT_GE(index_fd, 0) << "Failed to open file";
+  const int bulk_fd = cache.OpenFile(bulkPath);
+  ASSERT_GE(bulk_fd, 0) << "Failed to open file";
+
+  const int indexBlocks = 8;
+  WriteBlocks(cache, index_fd, indexBlocks);
+  ASSERT_EQ(cache.PinRange(index_fd, 0, indexBlocks * KBlockSize), 0);
+  ASSERT_EQ(cache.PinRange(index_fd, 0, 20 * KBlockSize), -1) << "Pinning past the cap should fail";
+  ASSERT_EQ(cache.GetStats().pinned_blocks, static_cast<size_t>(indexBlocks));
+
+  WriteBlocks(cache, bulk_fd, 256);
+  ReadBlocks(cache, bulk_fd, 256);
+  ASSERT_EQ(CountResident(cache, index_fd, indexBlocks), static_cast<size_t>(indexBlocks))
+      << "Pinned blocks were evicted";
+
+  ASSERT_EQ(cache.UnpinRange(index_fd, 0, indexBlocks * KBlockSize), 0);
+  ASSERT_EQ(cache.GetStats().pinned_blocks, 0U);
+  ReadBlocks(cache, bulk_fd, 256);
+  ASSERT_EQ(CountResident(cache, index_fd, indexBlocks), 0U) << "Unpinned blocks should age out";
+
+  ASSERT_EQ(cache.CloseFile(index_fd), 0);
+  ASSERT_EQ(cache.CloseFile(bulk_fd), 0);
+}
+
+// Test that the compressed tier growing never leaves pinned blocks over the capacity
+TEST_F(PinningTest, CompressedTierLeavesRoomForPins) {
+  CacheOptions options;
+  options.compressed_tier = true;
+  options.max_pinned_percent = 90;
+  FIFOCache cache(64, options);
+  const int index_fd = cache.OpenFile(indexPath);
+  ASSERT_GE(index_fd, 0) << "Failed to open file";
+  const int bulk_fd = cache.OpenFile(bulkPath);
+  ASSERT_GE(bulk_fd, 0) << "Failed to open file";
+
+  const int indexBlocks = 50;
+  const int bulkBlocks = 100;
+  WriteCompressibleBlocks(cache, index_fd, indexBlocks);
+  ASSERT_EQ(cache.PinRange(index_fd, 0, indexBlocks * KBlockSize), 0);
+  WriteCompressibleBlocks(cache, bulk_fd, bulkBlocks);
+
+  // Random reads hit the compressed tier often enough for it to grow
+  std::mt19937 engine(0);
+  std::string buffer(KBlockSize, '\0');
+  for (int i = 0; i < 4096; ++i) {
+    const off_t offset = static_cast<off_t>(engine() % bulkBlocks) * KBlockSize;
+    ASSERT_EQ(cache.LSeek(bulk_fd, offset, SEEK_SET), offset);
+    ASSERT_EQ(
+        cache.ReadFile(bulk_fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize)
+    );
+  }
+
+  const CacheStats stats = cache.GetStats();
+  ASSERT_GT(stats.compressed_hits, 0U);
+  ASSERT_LE(stats.frames + stats.compressed_capacity, 64U)
+      << "Pinned blocks left the cache over its capacity";
+  ASSERT_EQ(CountResident(cache, index_fd, indexBlocks), static_cast<size_t>(indexBlocks));
+
+  ASSERT_EQ(cache.CloseFile(index_fd), 0);
+  ASSERT_EQ(cache.CloseFile(bulk_fd), 0);
+}
+
+// Test that lower priority classes are evicted first
+TEST_F(PinningTest, PriorityClasses) {
+  FIFOCache cache(64);
+  const int index_fd = cache.OpenFile(indexPath);
+  ASSERT_GE(index_fd, 0) << "Failed to open file";
+  const int data_fd = cache.OpenFile(dataPath);
+  ASSERT_GE(data_fd, 0) << "Failed to open file";
+  const int bulk_fd = cache.OpenFile(bulkPath);
+  ASSERT_GE(bulk_fd, 0) << "Failed to open file";
+
+  ASSERT_EQ(cache.SetRangePriority(index_fd, 0, 1 << 20, LAB2_PRIORITY_HIGH), 0);
+  ASSERT_EQ(cache.SetRangePriority(bulk_fd, 0, 1 << 30, LAB2_PRIORITY_LOW), 0);
+  ASSERT_EQ(cache.SetRangePriority(bulk_fd, 0, 1, 7), -1) << "Unknown priority should fail";
+
+  const int indexBlocks = 16;
+  const int dataBlocks = 16;
+  WriteBlocks(cache, index_fd, indexBlocks);
+  WriteBlocks(cache, data_fd, dataBlocks);
+
+  // A low priority scan only evicts its own blocks
+  WriteBlocks(cache, bulk_fd, 256);
+  ReadBlocks(cache, bulk_fd, 256);
+  ASSERT_EQ(CountResident(cache, data_fd, dataBlocks), static_cast<size_t>(dataBlocks));
+  ASSERT_EQ(CountResident(cache, index_fd, indexBlocks), static_cast<size_t>(indexBlocks));
+
+  // A normal priority scan evicts low and normal blocks before high ones
+  ASSERT_EQ(cache.SetRangePriority(bulk_fd, 0, 1 << 30, LAB2_PRIORITY_NORMAL), 0);
+  ReadBlocks(cache, bulk_fd, 256);
+  ASSERT_EQ(CountResident(cache, index_fd, indexBlocks), static_cast<size_t>(indexBlocks));
+  ASSERT_LT(CountResident(cache, data_fd, dataBlocks), static_cast<size_t>(dataBlocks));
+
+  ASSERT_EQ(cache.CloseFile(index_fd), 0);
+  ASSERT_EQ(cache.CloseFile(data_fd), 0);
+  ASSERT_EQ(cache.CloseFile(bulk_fd), 0);
+}
+
+}  // namespace lab2
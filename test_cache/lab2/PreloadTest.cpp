@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace lab2 {
+
+class PreloadTest : public ::testing::Test {
+protected:
+  std::string inputPath = "/tmp/lab2_preload_in.tmp";
+  std::string outputPath = "/tmp/lab2_preload_out.tmp";
+  std::string statsPath = "/tmp/lab2_preload_stats.log";
+  std::string contents;
+
+  void SetUp() override {
+#ifndef LAB2_PRELOAD_PATH
+    GTEST_SKIP() << "Built without the preload shim";
+#endif
+    unlink(outputPath.c_str());
+    for (int i = 0; contents.size() < 3 * 4096 + 2048; ++i) {
+      contents += "line " + std::to_string(i) + "\n";
+    }
+    std::ofstream(inputPath) << contents;
+  }
+
+  void TearDown() override {
+    unlink(inputPath.c_str());
+    unlink(outputPath.c_str());
+    unlink(statsPath.c_str());
+  }
+
+  // Runs a shell command with the shim routing the test files, returning its output.
+  std::string RunPreloaded(const std::string& command) {
+#ifdef LAB2_PRELOAD_PATH
+    const std::string line = std::string("LD_PRELOAD=") + LAB2_PRELOAD_PATH +
+                             " LAB2_PRELOAD_PATTERN='/tmp/lab2_preload_*.tmp'" +
+                             " LAB2_PRELOAD_STATS=1 " + command + " 2>" + statsPath;
+#else
+    const std::string line = command;
+#endif
+    FILE* pipe = popen(line.c_str(), "r");
+    EXPECT_NE(pipe, nullptr);
+    std::string output;
+    char buffer[4096];
+    size_t size = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+      output.append(buffer, size);
+    }
+    EXPECT_EQ(pclose(pipe), 0) << "Command failed: " << line;
+    return output;
+  }
+
+  std::string ReadFile(const std::string& path) {
+    std::ifstream file(path);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  }
+};
+
+// Test that cat reads a routed file through the cache
+TEST_F(PreloadTest, Cat) {
+  ASSERT_EQ(RunPreloaded("cat " + inputPath), contents);
+
+  const std::string stats = ReadFile(statsPath);
+  ASSERT_NE(stats.find("opens=1 "), std::string::npos) << stats;
+  ASSERT_EQ(stats.find("reads=0 "), std::string::npos) << stats;
+}
+
+// Test that dd copies between two routed files, with a short tail block
+TEST_F(PreloadTest, Dd) {
+  RunPreloaded("dd if=" + inputPath + " of=" + outputPath + " bs=4096 conv=fsync status=none");
+  ASSERT_EQ(ReadFile(outputPath), contents);
+
+  const std::string stats = ReadFile(statsPath);
+  ASSERT_NE(stats.find("opens=2 "), std::string::npos) << stats;
+  ASSERT_EQ(stats.find("writes=0"), std::string::npos) << stats;
+}
+
+// Test that files opened through the fortified __open_2 are routed too
+TEST_F(PreloadTest, FortifiedOpen) {
+  if (std::system("command -v python3 >/dev/null") != 0) {
+    GTEST_SKIP() << "No python3 to call __open_2 from";
+  }
+  const std::string script =
+      "import ctypes, os, sys\n"
+      "libc = ctypes.CDLL(None)\n"
+      "fd = libc.__open_2(b'" + inputPath + "', os.O_RDONLY)\n"
+      "buf = ctypes.create_string_buffer(4096)\n"
+      "size = libc.read(fd, buf, 4096)\n"
+      "sys.stdout.buffer.write(buf.raw[:size])\n";
+  ASSERT_EQ(RunPreloaded("python3 -c \"" + script + "\""), contents.substr(0, 4096));
+
+  // The stats of each process started along the way are printed
+  const std::string stats = ReadFile(statsPath);
+  ASSERT_NE(stats.find("opens=1 reads=1 "), std::string::npos) << stats;
+}
+
+// Test that a feature failing to start is left out instead of killing the program
+TEST_F(PreloadTest, FailingFeatureFallsBack) {
+  ASSERT_EQ(RunPreloaded("LAB2_JOURNAL_PATH=/nonexistent/lab2.journal cat " + inputPath), contents);
+
+  const std::string stats = ReadFile(statsPath);
+  ASSERT_NE(stats.find("continuing without the journal"), std::string::npos) << stats;
+  ASSERT_NE(stats.find("opens=1 "), std::string::npos) << stats;
+}
+
+}  // namespace lab2
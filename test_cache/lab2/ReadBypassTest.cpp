@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "lab2/Cache.hpp"
+
+namespace lab2 {
+
+class ReadBypassTest : public ::testing::Test {
+protected:
+  std::string dataPath = "/tmp/read_bypass_test.tmp";
+  static constexpr size_t KFileBlocks = 2048;  // 8 MiB
+  // Blocks of a read large enough to always bypass the cache
+  static constexpr size_t KBypassBlocks = 512;  // 2 MiB
+
+  void SetUp() override {
+    std::ofstream out(dataPath, std::ios::binary | std::ios::trunc);
+    for (size_t i = 0; i < KFileBlocks; ++i) {
+      out << std::string(KBlockSize, Pattern(i));
+    }
+  }
+
+  void TearDown() override {
+    unlink(dataPath.c_str());
+  }
+
+  static char Pattern(size_t block) {
+    return static_cast<char>('a' + block % 26);
+  }
+
+  // Whether every block of buf, starting at first_block, holds its pattern.
+  static bool HoldsPatterns(const char* buf, size_t first_block, size_t numBlocks) {
+    for (size_t i = 0; i < numBlocks; ++i) {
+      if (std::string(buf + i * KBlockSize, KBlockSize) !=
+          std::string(KBlockSize, Pattern(first_block + i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static CacheOptions BypassOptions() {
+    CacheOptions options;
+    options.read_bypass = true;
+    return options;
+  }
+};
+
+// Test that a large read skips the cache, into aligned and unaligned buffers
+TEST_F(ReadBypassTest, LargeReadSkipsCache) {
+  FIFOCache cache(64, BypassOptions());
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const size_t numBlocks = 1024;
+  AlignedVec aligned(numBlocks * KBlockSize);
+  ASSERT_EQ(
+      cache.ReadFile(fd, aligned.data(), aligned.size()), static_cast<ssize_t>(aligned.size())
+  );
+  ASSERT_TRUE(HoldsPatterns(aligned.data(), 0, numBlocks));
+
+  // The partial block at the end goes through the cache
+  std::string unaligned((numBlocks - 1) * KBlockSize + 100, '\0');
+  ASSERT_EQ(
+      cache.ReadFile(fd, unaligned.data() + 1, unaligned.size() - 1),
+      static_cast<ssize_t>(unaligned.size() - 1)
+  );
+  ASSERT_TRUE(HoldsPatterns(unaligned.data() + 1, numBlocks, numBlocks - 1));
+
+  const CacheStats stats = cache.GetStats();
+  ASSERT_EQ(stats.bypass_reads, 2U);
+  ASSERT_EQ(stats.bypass_bytes, (2 * numBlocks - 1) * KBlockSize);
+  ASSERT_EQ(stats.misses, 1U) << "Bypassed blocks were admitted";
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that dirty cached blocks are read over the older data on disk
+TEST_F(ReadBypassTest, SeesDirtyBlocks) {
+  FIFOCache cache(64, BypassOptions());
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const std::string data(KBlockSize, 'Z');
+  ASSERT_EQ(
+      cache.PWriteFile(fd, data.data(), data.size(), 7 * KBlockSize),
+      static_cast<ssize_t>(KBlockSize)
+  );
+
+  AlignedVec buffer(KFileBlocks * KBlockSize);
+  ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(buffer.size()));
+  ASSERT_EQ(cache.GetStats().bypass_reads, 1U);
+  ASSERT_TRUE(HoldsPatterns(buffer.data(), 0, 7));
+  ASSERT_EQ(std::string(buffer.data() + 7 * KBlockSize, KBlockSize), data);
+  ASSERT_TRUE(HoldsPatterns(buffer.data() + 8 * KBlockSize, 8, KFileBlocks - 8));
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that bypass reads, which leave the lock to other threads, see every
+// write completed before them, even when written back during the read
+TEST_F(ReadBypassTest, SeesWritesBackedMeanwhile) {
+  const size_t numWritten = 32;
+  FIFOCache cache(8, BypassOptions());
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  // Each written block starts with the number of the pass that last wrote it
+  std::atomic<int> passes_done{0};
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    std::string data(KBlockSize, 'w');
+    for (int pass = 1; !stop; ++pass) {
+      std::memcpy(data.data(), &pass, sizeof(pass));
+      for (size_t i = 0; i < numWritten; ++i) {
+        cache.PWriteFile(fd, data.data(), data.size(), i * KBlockSize);
+      }
+      passes_done = pass;
+    }
+  });
+
+  AlignedVec buffer(KBypassBlocks * KBlockSize);
+  bool stale = false;
+  for (int round = 0; round < 50 && !stale; ++round) {
+    const int passes_before = passes_done;
+    ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(
+        cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(buffer.size())
+    );
+    for (size_t i = 0; i < numWritten && passes_before > 0; ++i) {
+      int pass = 0;
+      std::memcpy(&pass, buffer.data() + i * KBlockSize, sizeof(pass));
+      stale = stale || pass < passes_before;
+    }
+  }
+  stop = true;
+  writer.join();
+  ASSERT_FALSE(stale) << "Bypass read missed a completed write";
+  ASSERT_GT(cache.GetStats().bypass_reads, 0U);
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that smaller reads bypass the cache only once a sequential scan is detected
+TEST_F(ReadBypassTest, ScanLowersThreshold) {
+  FIFOCache cache(64, BypassOptions());
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const size_t chunkBlocks = 32;  // 128 KiB
+  AlignedVec buffer(chunkBlocks * KBlockSize);
+
+  // Random reads of the same size never bypass it
+  const ssize_t chunkSize = static_cast<ssize_t>(buffer.size());
+  for (off_t chunk : {40, 3, 17, 50, 9, 28}) {
+    ASSERT_EQ(cache.LSeek(fd, chunk * chunkSize, SEEK_SET), chunk * chunkSize);
+    ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), chunkSize);
+  }
+  ASSERT_EQ(cache.GetStats().bypass_reads, 0U);
+
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  for (size_t chunk = 0; chunk < KFileBlocks / chunkBlocks; ++chunk) {
+    ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), chunkSize);
+    ASSERT_TRUE(HoldsPatterns(buffer.data(), chunk * chunkBlocks, chunkBlocks)) << chunk;
+  }
+
+  // The first 4 MiB went through the cache, the rest bypassed it
+  ASSERT_EQ(cache.GetStats().bypass_reads, KFileBlocks / chunkBlocks / 2);
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+}  // namespace lab2
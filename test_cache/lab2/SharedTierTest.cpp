@@ -0,0 +1,245 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "lab2/Cache.hpp"
+#include "lab2/SharedTier.hpp"
+
+namespace lab2 {
+
+class SharedTierTest : public ::testing::Test {
+protected:
+  std::string tierName = "/lab2_shared_tier_test";
+  std::string dataPath = "/tmp/shared_tier_test.tmp";
+
+  void SetUp() override {
+    SharedTier::Unlink(tierName);
+    unlink(dataPath.c_str());
+  }
+
+  void TearDown() override {
+    SharedTier::Unlink(tierName);
+    unlink(dataPath.c_str());
+  }
+
+  // Whether the block is stored with every byte equal to value.
+  static bool Holds(SharedTier& tier, const SharedFileKey& file, uint64_t block, char value) {
+    AlignedVec data;
+    return tier.Get(file, block, data) && data.size() == KBlockSize &&
+           std::all_of(data.begin(), data.end(), [value](char c) { return c == value; });
+  }
+};
+
+// Test that blocks stored through one attachment are seen through another
+TEST_F(SharedTierTest, PublishFillErase) {
+  SharedTier tier(tierName, 64);
+  SharedTier other(tierName, 64);
+  const SharedFileKey file{1, 2};
+  const std::string a(KBlockSize, 'a');
+  const std::string b(KBlockSize, 'b');
+
+  tier.Publish(file, 0, a.data());
+  ASSERT_TRUE(Holds(other, file, 0, 'a'));
+  ASSERT_FALSE(Holds(other, SharedFileKey{1, 3}, 0, 'a')) << "Another file matched";
+
+  // A fill racing with a rewrite of the block is dropped
+  const uint64_t token = other.FillToken(file, 1);
+  tier.Publish(file, 1, b.data());
+  tier.Erase(file, 1);
+  other.Fill(file, 1, a.data(), token);
+  AlignedVec data;
+  ASSERT_FALSE(other.Get(file, 1, data)) << "Stale fill was stored";
+
+  other.Fill(file, 1, b.data(), other.FillToken(file, 1));
+  ASSERT_TRUE(Holds(tier, file, 1, 'b'));
+
+  tier.EraseFrom(file, 1);
+  ASSERT_TRUE(Holds(tier, file, 0, 'a'));
+  ASSERT_FALSE(tier.Get(file, 1, data));
+  ASSERT_EQ(tier.GetStats().entries, 1U);
+
+  // More blocks than fit replace the oldest ones
+  for (uint64_t block = 0; block < 256; ++block) {
+    tier.Publish(file, block, b.data());
+  }
+  ASSERT_LE(other.GetStats().entries, 64U);
+  ASSERT_GT(other.GetStats().evictions, 0U);
+  ASSERT_TRUE(Holds(other, file, 255, 'b'));
+}
+
+// Test that a second cache serves its misses from blocks the first one read
+TEST_F(SharedTierTest, CachesShareCleanBlocks) {
+  const int numBlocks = 8;
+  {
+    std::ofstream out(dataPath, std::ios::binary);
+    for (int i = 0; i < numBlocks; ++i) {
+      out << std::string(KBlockSize, static_cast<char>('a' + i));
+    }
+  }
+  CacheOptions options;
+  options.shared_tier_name = tierName;
+  options.shared_tier_blocks = 256;
+  FIFOCache first(16, options);
+  FIFOCache second(16, options);
+
+  const int first_fd = first.OpenFile(dataPath);
+  ASSERT_GE(first_fd, 0) << "Failed to open file";
+  const int second_fd = second.OpenFile(dataPath);
+  ASSERT_GE(second_fd, 0) << "Failed to open file";
+
+  std::string buffer(KBlockSize, '\0');
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_EQ(
+        first.ReadFile(first_fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize)
+    );
+  }
+  ASSERT_EQ(first.GetStats().shared_blocks, static_cast<size_t>(numBlocks));
+
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_EQ(
+        second.ReadFile(second_fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize)
+    );
+    ASSERT_EQ(buffer, std::string(KBlockSize, static_cast<char>('a' + i))) << "Block " << i;
+  }
+  ASSERT_EQ(second.GetStats().shared_hits, static_cast<size_t>(numBlocks));
+  ASSERT_EQ(second.GetStats().frames, 0U) << "Shared hits were copied into the private cache";
+  ASSERT_EQ(first.GetStats().shared_hits, 0U);
+
+  // Rewritten blocks leave the tier, and come back once written home
+  const std::string data(KBlockSize, 'z');
+  ASSERT_EQ(first.LSeek(first_fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(first.WriteFile(first_fd, data.data(), data.size()), static_cast<ssize_t>(KBlockSize));
+  ASSERT_EQ(first.GetStats().shared_blocks, static_cast<size_t>(numBlocks - 1));
+  ASSERT_EQ(first.SyncFile(first_fd), 0);
+  ASSERT_EQ(first.GetStats().shared_blocks, static_cast<size_t>(numBlocks));
+
+  ASSERT_EQ(first.TruncateFile(first_fd, KBlockSize / 2), 0);
+  ASSERT_EQ(second.GetStats().shared_blocks, 0U) << "Truncated blocks left in the tier";
+
+  ASSERT_EQ(first.CloseFile(first_fd), 0);
+  ASSERT_EQ(second.CloseFile(second_fd), 0);
+}
+
+// Test that blocks outlive writebacks made through the tier, but not a
+// rewrite of the file around it
+TEST_F(SharedTierTest, ReopenKeepsBlocks) {
+  const int numBlocks = 4;
+  CacheOptions options;
+  options.shared_tier_name = tierName;
+  options.shared_tier_blocks = 256;
+  FIFOCache writer(16, options);
+  FIFOCache reader(16, options);
+
+  const int writer_fd = writer.OpenFile(dataPath);
+  ASSERT_GE(writer_fd, 0) << "Failed to open file";
+  for (int i = 0; i < numBlocks; ++i) {
+    const std::string data(KBlockSize, static_cast<char>('a' + i));
+    ASSERT_EQ(
+        writer.WriteFile(writer_fd, data.data(), data.size()), static_cast<ssize_t>(KBlockSize)
+    );
+  }
+  ASSERT_EQ(writer.SyncFile(writer_fd), 0);
+  ASSERT_EQ(writer.CloseFile(writer_fd), 0);
+
+  // Opened after the writeback changed the file's ctime
+  int reader_fd = reader.OpenFile(dataPath);
+  ASSERT_GE(reader_fd, 0) << "Failed to open file";
+  std::string buffer(KBlockSize, '\0');
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_EQ(
+        reader.ReadFile(reader_fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize)
+    );
+    ASSERT_EQ(buffer, std::string(KBlockSize, static_cast<char>('a' + i))) << "Block " << i;
+  }
+  ASSERT_EQ(reader.GetStats().shared_hits, static_cast<size_t>(numBlocks));
+  ASSERT_EQ(reader.CloseFile(reader_fd), 0);
+
+  // Rewritten without the tier, the file must not be served its old blocks
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  {
+    std::ofstream out(dataPath, std::ios::binary | std::ios::in);
+    out << std::string(KBlockSize, 'z');
+  }
+  reader_fd = reader.OpenFile(dataPath);
+  ASSERT_GE(reader_fd, 0) << "Failed to open file";
+  ASSERT_EQ(
+      reader.ReadFile(reader_fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize)
+  );
+  ASSERT_EQ(buffer, std::string(KBlockSize, 'z')) << "Stale block served after a rewrite";
+  ASSERT_EQ(reader.GetStats().shared_hits, static_cast<size_t>(numBlocks));
+  ASSERT_EQ(reader.CloseFile(reader_fd), 0);
+}
+
+// Test that a process killed while storing blocks leaves the tier usable
+TEST_F(SharedTierTest, SurvivesKilledProcess) {
+  const SharedFileKey file{1, 2};
+  const uint64_t numBlocks = 32;
+  SharedTier tier(tierName, 16);
+
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    SharedTier child(tierName, 16);
+    for (uint64_t i = 0;; ++i) {
+      const std::string data(KBlockSize, static_cast<char>('a' + i % 26));
+      child.Publish(file, i % numBlocks, data.data());
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_EQ(kill(pid, SIGKILL), 0);
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+
+  // Every stored block is whole, and every shard can still be locked
+  for (uint64_t block = 0; block < numBlocks; ++block) {
+    AlignedVec data;
+    if (tier.Get(file, block, data)) {
+      ASSERT_TRUE(Holds(tier, file, block, data[0])) << "Torn block " << block;
+    }
+  }
+  const std::string data(KBlockSize, 'z');
+  for (uint64_t block = 0; block < numBlocks; ++block) {
+    tier.Publish(file, block, data.data());
+    ASSERT_TRUE(Holds(tier, file, block, 'z'));
+  }
+  ASSERT_LE(tier.GetStats().entries, 16U);
+}
+
+
+// Test that a segment left uninitialized by a dead creator is created again
+TEST_F(SharedTierTest, RecreatesAbandonedSegment) {
+  // A segment of the right size whose header was never written, as left by a
+  // creator killed between sizing and initializing it
+  struct stat stat_data = {};
+  {
+    SharedTier tier(tierName, 16);
+    const int fd = shm_open(tierName.c_str(), O_RDONLY, 0);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(fstat(fd, &stat_data), 0);
+    close(fd);
+  }
+  ASSERT_EQ(SharedTier::Unlink(tierName), 0);
+  const int fd = shm_open(tierName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, stat_data.st_size), 0);
+  close(fd);
+
+  SharedTier tier(tierName, 16);
+  SharedTier other(tierName, 16);
+  const SharedFileKey file{1, 2};
+  const std::string data(KBlockSize, 'a');
+  tier.Publish(file, 0, data.data());
+  ASSERT_TRUE(Holds(other, file, 0, 'a')) << "Attached to another segment";
+}
+
+}  // namespace lab2
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "lab2/Cache.hpp"
+
+namespace lab2 {
+
+// Reads the first numBlocks blocks of the file, one block at a time.
+inline void ReadBlocks(FIFOCache& cache, int fd, int numBlocks) {
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  std::string buffer(KBlockSize, '\0');
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_GE(cache.ReadFile(fd, buffer.data(), buffer.size()), 0);
+  }
+}
+
+// Writes numBlocks blocks at the file position, the i-th one filled with 'a' + i % 26.
+inline void WriteBlocks(FIFOCache& cache, int fd, int numBlocks) {
+  for (int i = 0; i < numBlocks; ++i) {
+    const std::string data(KBlockSize, static_cast<char>('a' + i % 26));
+    ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(KBlockSize));
+  }
+}
+
+}  // namespace lab2
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lab2/Cache.hpp"
+
+namespace lab2 {
+
+class ThreadCacheTest : public ::testing::Test {
+protected:
+  std::string tempFilePath = "/tmp/thread_cache_test.tmp";
+
+  void SetUp() override {
+    unlink(tempFilePath.c_str());
+  }
+
+  void TearDown() override {
+    unlink(tempFilePath.c_str());
+  }
+};
+
+// Test that repeated reads stay correct across writes made after they were cached
+TEST_F(ThreadCacheTest, WriteInvalidatesFrontCache) {
+  CacheOptions options;
+  options.thread_cache = true;
+  FIFOCache cache(16, options);
+
+  const int fd = cache.OpenFile(tempFilePath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const std::string first(4096, 'a');
+  ASSERT_EQ(cache.WriteFile(fd, first.data(), first.size()), 4096);
+
+  char readBuffer[4096];
+  const size_t hits = cache.GetStats().hits;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(cache.ReadFile(fd, readBuffer, sizeof(readBuffer)), 4096);
+    ASSERT_EQ(std::string(readBuffer, sizeof(readBuffer)), first);
+  }
+  ASSERT_EQ(cache.GetStats().hits, hits + 3) << "Front cache hits were not counted";
+
+  ASSERT_EQ(cache.LSeek(fd, 100, SEEK_SET), 100);
+  ASSERT_EQ(cache.WriteFile(fd, "xyz", 3), 3);
+
+  ASSERT_EQ(cache.LSeek(fd, 99, SEEK_SET), 99);
+  ASSERT_EQ(cache.ReadFile(fd, readBuffer, 5), 5);
+  ASSERT_EQ(std::string(readBuffer, 5), "axyza") << "Stale data served after a write";
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_CUR), 104) << "Position not advanced";
+
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+  ASSERT_EQ(cache.ReadFile(fd, readBuffer, 5), -1) << "Read succeeded after close";
+}
+
+// Test concurrent readers, each with its own file position, under evictions
+TEST_F(ThreadCacheTest, ConcurrentReaders) {
+  CacheOptions options;
+  options.thread_cache = true;
+  FIFOCache cache(4, options);
+
+  const int writer_fd = cache.OpenFile(tempFilePath);
+  ASSERT_GE(writer_fd, 0) << "Failed to open file";
+  for (int i = 0; i < 8; ++i) {
+    const std::string data(4096, static_cast<char>('a' + i));
+    ASSERT_EQ(cache.WriteFile(writer_fd, data.data(), data.size()), 4096);
+  }
+  ASSERT_EQ(cache.SyncFile(writer_fd), 0);
+
+  std::vector<std::thread> readers;
+  std::vector<int> errors(4, 0);
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&, t] {
+      const int fd = cache.OpenFile(tempFilePath);
+      char buffer[512];
+      for (int i = 0; i < 2000; ++i) {
+        const int block = (i + t) % 8;
+        cache.LSeek(fd, block * 4096 + 1000, SEEK_SET);
+        if (cache.ReadFile(fd, buffer, sizeof(buffer)) != sizeof(buffer) ||
+            buffer[0] != 'a' + block || buffer[sizeof(buffer) - 1] != 'a' + block) {
+          ++errors[t];
+        }
+      }
+      cache.CloseFile(fd);
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  for (int t = 0; t < 4; ++t) {
+    ASSERT_EQ(errors[t], 0) << "Reader " << t << " got wrong data";
+  }
+  ASSERT_EQ(cache.CloseFile(writer_fd), 0);
+}
+
+}  // namespace lab2
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lab2/Cache.hpp"
+#include "lab2/Trace.hpp"
+
+namespace lab2 {
+
+class TraceTest : public ::testing::Test {
+protected:
+  std::string tracePath = "/tmp/trace_test.json";
+  std::string dataPath = "/tmp/trace_test.tmp";
+
+  void SetUp() override {
+    ClearTrace();
+  }
+
+  void TearDown() override {
+    unlink(tracePath.c_str());
+    unlink(dataPath.c_str());
+  }
+
+  static size_t CountEvents(
+      const std::vector<TraceRecord>& records,
+      TraceEvent event,
+      uint64_t arg
+  ) {
+    return std::count_if(records.begin(), records.end(), [&](const TraceRecord& record) {
+      return record.event == event && record.arg == arg;
+    });
+  }
+};
+
+// Test that each thread's buffer keeps its latest events and exports them
+TEST_F(TraceTest, RingBuffersAndChromeExport) {
+  const uint64_t overflowArg = 1;
+  const uint64_t spanArg = 2;
+  {
+    const TraceScope scope(TraceEvent::Evict, spanArg);
+  }
+  std::thread writer([&] {
+    for (size_t i = 0; i < 3 * KTraceBufferEvents; ++i) {
+      RecordTrace(TraceEvent::LookupHit, TraceNow(), 0, overflowArg);
+    }
+  });
+  writer.join();
+
+  // The snapshot skips the slot a writer could be overwriting
+  const std::vector<TraceRecord> records = SnapshotTrace();
+  const size_t overflowEvents = CountEvents(records, TraceEvent::LookupHit, overflowArg);
+  ASSERT_LE(overflowEvents, KTraceBufferEvents);
+  ASSERT_GE(overflowEvents, KTraceBufferEvents - 1);
+  ASSERT_EQ(CountEvents(records, TraceEvent::Evict, spanArg), 1U);
+
+  ASSERT_EQ(WriteChromeTrace(tracePath), static_cast<ssize_t>(records.size()));
+  std::ifstream file(tracePath);
+  const std::string json{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  ASSERT_EQ(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0U);
+  ASSERT_NE(json.find("\"name\":\"evict\""), std::string::npos);
+  ASSERT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+
+  ClearTrace();
+  ASSERT_TRUE(SnapshotTrace().empty());
+}
+
+// Test that the cache's trace points record misses and hits, when compiled in
+TEST_F(TraceTest, CacheTracePoints) {
+#ifndef LAB2_TRACE
+  GTEST_SKIP() << "Built without trace points";
+#endif
+  FIFOCache cache(16);
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  const std::string data(KBlockSize, 'x');
+  ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+
+  const int read_fd = cache.OpenFile(dataPath);
+  ASSERT_GE(read_fd, 0) << "Failed to open file";
+  std::string buffer(KBlockSize, '\0');
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(cache.LSeek(read_fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(
+        cache.ReadFile(read_fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize)
+    );
+  }
+
+  const std::vector<TraceRecord> records = SnapshotTrace();
+  const uint64_t block_id = static_cast<uint64_t>(read_fd) << KFdOffset;
+  ASSERT_EQ(CountEvents(records, TraceEvent::LookupMiss, block_id), 1U);
+  ASSERT_EQ(CountEvents(records, TraceEvent::Fetch, block_id), 1U);
+  ASSERT_EQ(CountEvents(records, TraceEvent::LookupHit, block_id), 1U);
+  ASSERT_EQ(CountEvents(records, TraceEvent::Sync, fd), 1U);
+  ASSERT_GT(CountEvents(records, TraceEvent::LockWait, 0), 0U);
+  ASSERT_EQ(cache.CloseFile(read_fd), 0);
+}
+
+}  // namespace lab2
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "lab2/Cache.hpp"
+#include "lab2/VictimCache.hpp"
+
+namespace lab2 {
+
+class VictimCacheTest : public ::testing::Test {
+protected:
+  std::string victimPath = "/tmp/victim_cache_test.l2";
+  std::string dataPath = "/tmp/victim_cache_test.tmp";
+
+  void SetUp() override {
+    unlink(victimPath.c_str());
+    unlink(dataPath.c_str());
+  }
+
+  void TearDown() override {
+    unlink(victimPath.c_str());
+    unlink(dataPath.c_str());
+  }
+};
+
+// Test lookups before and after the background writer stored the blocks
+TEST_F(VictimCacheTest, PutGetInvalidate) {
+  VictimCache victim(victimPath, 4);
+
+  const std::string first(KBlockSize, 'a');
+  const std::string tail(100, 'b');
+  victim.Put(1, first.data(), first.size());
+  victim.Put(2, tail.data(), tail.size());
+
+  AlignedVec data;
+  ASSERT_TRUE(victim.Get(1, data)) << "Queued block not found";
+  ASSERT_EQ(std::string(data.begin(), data.end()), first);
+
+  victim.Flush();
+  ASSERT_TRUE(victim.Get(2, data)) << "Written block not found";
+  ASSERT_EQ(std::string(data.begin(), data.end()), tail);
+
+  victim.Invalidate(1);
+  ASSERT_FALSE(victim.Get(1, data)) << "Invalidated block found";
+
+  // Filling the file replaces unreferenced blocks
+  for (uint64_t id = 10; id < 20; ++id) {
+    victim.Put(id, first.data(), first.size());
+    victim.Flush();
+  }
+  ASSERT_LE(victim.GetStats().entries, 4U);
+  ASSERT_TRUE(victim.Get(19, data));
+}
+
+// Test that misses are served from the victim cache and rewrites invalidate it
+TEST_F(VictimCacheTest, CacheServesMissesFromVictimCache) {
+  CacheOptions options;
+  options.victim_cache_path = victimPath;
+  options.victim_cache_blocks = 64;
+  FIFOCache cache(4, options);
+
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const int numBlocks = 16;
+  for (int i = 0; i < numBlocks; ++i) {
+    const std::string data(KBlockSize, static_cast<char>('a' + i));
+    ASSERT_EQ(cache.WriteFile(fd, data.data(), data.size()), static_cast<ssize_t>(KBlockSize));
+  }
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+
+  // Rewrite block 0 after it was demoted to the victim cache
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(cache.WriteFile(fd, "zz", 2), 2);
+
+  for (int round = 0; round < 2; ++round) {
+    ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+    for (int i = 0; i < numBlocks; ++i) {
+      std::string buffer(KBlockSize, '\0');
+      ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+      std::string expected(KBlockSize, static_cast<char>('a' + i));
+      if (i == 0) {
+        expected.replace(0, 2, "zz");
+      }
+      ASSERT_EQ(buffer, expected) << "Data mismatch at block " << i;
+    }
+  }
+
+  ASSERT_GT(cache.GetStats().victim_hits, 0U) << "No miss was served by the victim cache";
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+}  // namespace lab2
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "lab2/Cache.hpp"
+#include "lab2/TestUtil.hpp"
+
+namespace lab2 {
+
+class WriteModeTest : public ::testing::Test {
+protected:
+  std::string dataPath = "/tmp/write_mode_test.tmp";
+
+  void SetUp() override {
+    unlink(dataPath.c_str());
+  }
+
+  void TearDown() override {
+    unlink(dataPath.c_str());
+  }
+
+  // Contents of the file on disk, bypassing the cache.
+  std::string ReadHome() const {
+    std::ifstream file(dataPath, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  }
+};
+
+// Test that write-back keeps writes in the cache until they are evicted
+TEST_F(WriteModeTest, WriteBackDirtiesCache) {
+  FIFOCache cache(16);
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  WriteBlocks(cache, fd, 4);
+  ASSERT_TRUE(ReadHome().empty()) << "Write-back wrote to disk before eviction";
+  WriteBlocks(cache, fd, 28);
+
+  const CacheStats stats = cache.GetStats();
+  const WriteModeStats& mode = stats.write_modes[LAB2_WRITE_BACK];
+  ASSERT_EQ(mode.blocks, 32U);
+  ASSERT_EQ(mode.admitted_blocks, 32U);
+  ASSERT_EQ(mode.disk_writes, 0U);
+  ASSERT_EQ(stats.dirty_evictions, 16U);
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that write-through writes reach the disk at once and leave clean blocks
+TEST_F(WriteModeTest, WriteThroughKeepsBlocksClean) {
+  FIFOCache cache(16);
+  const lab2_open_options options = {nullptr, LAB2_WRITE_THROUGH};
+  const int fd = cache.OpenFile(dataPath, &options);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  WriteBlocks(cache, fd, 32);
+  const std::string home = ReadHome();
+  ASSERT_EQ(home.size(), 32 * KBlockSize);
+  ASSERT_EQ(home[31 * KBlockSize], 'a' + 31 % 26);
+
+  const CacheStats stats = cache.GetStats();
+  const WriteModeStats& mode = stats.write_modes[LAB2_WRITE_THROUGH];
+  ASSERT_EQ(mode.blocks, 32U);
+  ASSERT_EQ(mode.admitted_blocks, 32U);
+  ASSERT_EQ(mode.disk_writes, 32U);
+  ASSERT_EQ(stats.dirty_evictions, 0U);
+
+  // The last blocks written are cached
+  std::string buffer(KBlockSize, '\0');
+  ASSERT_EQ(cache.LSeek(fd, 31 * KBlockSize, SEEK_SET), 31 * static_cast<off_t>(KBlockSize));
+  ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+  ASSERT_EQ(cache.GetStats().hits, stats.hits + 1);
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+// Test that write-around writes skip the cache but update cached blocks
+TEST_F(WriteModeTest, WriteAroundSkipsCache) {
+  FIFOCache cache(16);
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+  WriteBlocks(cache, fd, 2);
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+
+  ASSERT_EQ(cache.SetWriteMode(fd, KNumWriteModes), -1);
+  ASSERT_EQ(cache.SetWriteMode(fd, LAB2_WRITE_AROUND), 0);
+  WriteBlocks(cache, fd, 30);
+
+  // A partial write of a block that is not cached keeps the rest of it,
+  // read from disk without counting as a read miss
+  const size_t misses = cache.GetStats().misses;
+  const std::string patch(100, 'Z');
+  ASSERT_EQ(
+      cache.PWriteFile(fd, patch.data(), patch.size(), 5 * KBlockSize + 10),
+      static_cast<ssize_t>(patch.size())
+  );
+  ASSERT_EQ(cache.GetStats().misses, misses);
+  // A cached block is updated in place
+  ASSERT_EQ(
+      cache.PWriteFile(fd, patch.data(), patch.size(), 0), static_cast<ssize_t>(patch.size())
+  );
+
+  const CacheStats stats = cache.GetStats();
+  const WriteModeStats& mode = stats.write_modes[LAB2_WRITE_AROUND];
+  ASSERT_EQ(mode.blocks, 32U);
+  ASSERT_EQ(mode.admitted_blocks, 0U);
+  ASSERT_EQ(mode.disk_writes, 32U);
+  ASSERT_EQ(stats.frames, 2U) << "Write-around loaded blocks into the cache";
+
+  const std::string home = ReadHome();
+  ASSERT_EQ(home.size(), 32 * KBlockSize);
+  ASSERT_EQ(home.substr(0, 100), patch);
+  ASSERT_EQ(home[100], 'a');
+  ASSERT_EQ(home.substr(5 * KBlockSize, 10), std::string(10, 'd'));
+  ASSERT_EQ(home.substr(5 * KBlockSize + 10, 100), patch);
+  ASSERT_EQ(home[5 * KBlockSize + 110], 'd');
+
+  std::string buffer(KBlockSize, '\0');
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+  ASSERT_EQ(buffer, home.substr(0, KBlockSize));
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+
+  const lab2_open_options unknown = {nullptr, static_cast<int>(KNumWriteModes)};
+  ASSERT_EQ(cache.OpenFile(dataPath, &unknown), -1);
+}
+
+// Test that write-around drops the older copy of a block held compressed
+TEST_F(WriteModeTest, WriteAroundDropsCompressedCopy) {
+  CacheOptions options;
+  options.compressed_tier = true;
+  FIFOCache cache(64, options);
+  const int fd = cache.OpenFile(dataPath);
+  ASSERT_GE(fd, 0) << "Failed to open file";
+
+  const int numBlocks = 200;
+  const std::string old_data(KBlockSize, 'A');
+  std::string buffer(KBlockSize, '\0');
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_EQ(
+        cache.WriteFile(fd, old_data.data(), old_data.size()), static_cast<ssize_t>(KBlockSize)
+    );
+  }
+  ASSERT_EQ(cache.SyncFile(fd), 0);
+  ASSERT_EQ(cache.LSeek(fd, 0, SEEK_SET), 0);
+  for (int i = 0; i < numBlocks; ++i) {
+    ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+  }
+  ASSERT_GT(cache.GetStats().compressed_blocks, 0U);
+
+  // Block 130 left the cache compressed, and is rewritten whole around it
+  const off_t offset = 130 * static_cast<off_t>(KBlockSize);
+  const size_t compressed_blocks = cache.GetStats().compressed_blocks;
+  ASSERT_EQ(cache.SetWriteMode(fd, LAB2_WRITE_AROUND), 0);
+  const std::string new_data(KBlockSize, 'B');
+  ASSERT_EQ(
+      cache.PWriteFile(fd, new_data.data(), new_data.size(), offset),
+      static_cast<ssize_t>(KBlockSize)
+  );
+  ASSERT_EQ(cache.GetStats().compressed_blocks, compressed_blocks - 1)
+      << "Block 130 was not held compressed";
+
+  ASSERT_EQ(cache.LSeek(fd, offset, SEEK_SET), offset);
+  ASSERT_EQ(cache.ReadFile(fd, buffer.data(), buffer.size()), static_cast<ssize_t>(KBlockSize));
+  ASSERT_EQ(buffer, new_data) << "Stale compressed copy was read";
+  ASSERT_EQ(cache.CloseFile(fd), 0);
+}
+
+}  // namespace lab2